@@ -0,0 +1,356 @@
+/** \file
+ * Benchmark suite for the core operations on generated trees.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Include the generated file.
+#include "bench.hpp"
+
+/**
+ * Generator for random benchmark trees. The generated trees only depend on
+ * the seed, so results are comparable across runs and releases.
+ */
+class Generator {
+private:
+
+    /**
+     * The random number generator.
+     */
+    std::mt19937_64 rng;
+
+    /**
+     * All items generated for the tree currently being generated, used to
+     * pick link targets from.
+     */
+    std::vector<bench::One<bench::Item>> items;
+
+    /**
+     * Returns a random integer in the range [0, n).
+     */
+    size_t random(size_t n) {
+        return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+    }
+
+    /**
+     * Fills the payload fields of a newly constructed item and registers it
+     * as a possible link target.
+     */
+    template <class T>
+    bench::One<T> fill(bench::One<T> item) {
+        item->value = static_cast<primitives::Int>(rng() >> 16u);
+        item->label = "item" + std::to_string(items.size());
+        items.emplace_back(item);
+        return item;
+    }
+
+    /**
+     * Generates a random subtree of at most the given number of nodes, with
+     * the given remaining depth.
+     */
+    bench::One<bench::Item> random_item(size_t &budget, size_t depth) {
+        budget--;
+        size_t kind = (budget && depth) ? random(8) : (items.empty() ? 0 : random(2) * 3);
+        if (kind == 3) {
+            auto ref = fill(tree::base::make<bench::Ref>());
+            ref->target = bench::Link<bench::Item>(items.at(random(items.size())));
+            return ref;
+        } else if (kind == 4 || kind == 5) {
+            auto chain = fill(tree::base::make<bench::Chain>());
+            chain->next = random_item(budget, depth - 1);
+            return chain;
+        } else if (kind >= 6) {
+            auto group = fill(tree::base::make<bench::Group>());
+            size_t count = random(8);
+            for (size_t i = 0; i < count && budget; i++) {
+                group->children.add(random_item(budget, depth - 1));
+            }
+            return group;
+        }
+        return fill(tree::base::make<bench::Leaf>());
+    }
+
+public:
+
+    /**
+     * Constructs a generator with the given seed.
+     */
+    explicit Generator(uint64_t seed) : rng(seed), items() {}
+
+    /**
+     * Generates a chain of Chain nodes of the given depth.
+     */
+    bench::One<bench::Root> deep_chain(size_t depth) {
+        items.clear();
+        bench::Maybe<bench::Item> tail = fill(tree::base::make<bench::Leaf>());
+        for (size_t i = 1; i < depth; i++) {
+            auto chain = fill(tree::base::make<bench::Chain>());
+            chain->next = tail;
+            tail = chain;
+        }
+        auto root = tree::base::make<bench::Root>();
+        root->items.add(tail);
+        return root;
+    }
+
+    /**
+     * Generates a single Group with the given number of leaves.
+     */
+    bench::One<bench::Root> wide_list(size_t width) {
+        items.clear();
+        auto group = fill(tree::base::make<bench::Group>());
+        for (size_t i = 0; i < width; i++) {
+            group->children.add(fill(tree::base::make<bench::Leaf>()));
+        }
+        auto root = tree::base::make<bench::Root>();
+        root->items.add(group);
+        return root;
+    }
+
+    /**
+     * Generates the given number of leaves and the same number of Ref nodes
+     * that link to random leaves.
+     */
+    bench::One<bench::Root> link_heavy(size_t count) {
+        items.clear();
+        auto root = tree::base::make<bench::Root>();
+        for (size_t i = 0; i < count; i++) {
+            root->items.add(fill(tree::base::make<bench::Leaf>()));
+        }
+        for (size_t i = 0; i < count; i++) {
+            auto ref = fill(tree::base::make<bench::Ref>());
+            ref->target = bench::Link<bench::Item>(items.at(random(count)));
+            root->items.add(ref);
+        }
+        return root;
+    }
+
+    /**
+     * Generates the given number of leaves, each carrying four annotations.
+     */
+    bench::One<bench::Root> annotation_heavy(size_t count) {
+        items.clear();
+        auto root = tree::base::make<bench::Root>();
+        for (size_t i = 0; i < count; i++) {
+            auto leaf = fill(tree::base::make<bench::Leaf>());
+            leaf->set_annotation(primitives::Note<0>(leaf->value));
+            leaf->set_annotation(primitives::Note<1>(leaf->value + 1));
+            leaf->set_annotation(primitives::Note<2>(leaf->value + 2));
+            leaf->set_annotation(primitives::Note<3>(leaf->value + 3));
+            root->items.add(leaf);
+        }
+        return root;
+    }
+
+    /**
+     * Generates a random tree of at most the given number of nodes, using
+     * all node types of the schema.
+     */
+    bench::One<bench::Root> random_tree(size_t size) {
+        items.clear();
+        auto root = tree::base::make<bench::Root>();
+        while (size) {
+            root->items.add(random_item(size, 32));
+        }
+        return root;
+    }
+
+};
+
+/**
+ * Visitor that sums the values of all items, to measure traversal speed.
+ */
+class Summer : public bench::RecursiveVisitor {
+public:
+
+    /**
+     * Sum of all values and number of nodes visited.
+     */
+    primitives::Int sum = 0;
+    size_t count = 0;
+
+    void visit_node(bench::Node &) override {
+        count++;
+    }
+
+    void visit_item(bench::Item &node) override {
+        sum += node.value;
+        count++;
+    }
+
+    void visit_chain(bench::Chain &node) override {
+        sum += node.value;
+        bench::RecursiveVisitor::visit_chain(node);
+    }
+
+    void visit_group(bench::Group &node) override {
+        sum += node.value;
+        bench::RecursiveVisitor::visit_group(node);
+    }
+
+};
+
+/**
+ * Benchmark configuration and result output.
+ */
+class Runner {
+private:
+
+    /**
+     * Minimum time to spend on each operation, in seconds.
+     */
+    double min_time;
+
+    /**
+     * Whether to output JSON lines rather than CSV.
+     */
+    bool json;
+
+public:
+
+    /**
+     * Constructs a runner.
+     */
+    Runner(double min_time, bool json) : min_time(min_time), json(json) {
+        if (!json) {
+            std::cout << "scenario,operation,nodes,iterations,seconds,nodes_per_second" << std::endl;
+        }
+    }
+
+    /**
+     * Runs the given operation repeatedly until at least min_time has
+     * elapsed, and reports the average time per iteration.
+     */
+    void run(
+        const std::string &scenario,
+        const std::string &operation,
+        size_t nodes,
+        const std::function<void()> &fn
+    ) {
+        typedef std::chrono::steady_clock Clock;
+        size_t iterations = 0;
+        auto start = Clock::now();
+        double elapsed;
+        do {
+            fn();
+            iterations++;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < min_time);
+        double seconds = elapsed / iterations;
+        double throughput = nodes / seconds;
+        if (json) {
+            std::cout << "{\"scenario\": \"" << scenario << "\", \"operation\": \"" << operation;
+            std::cout << "\", \"nodes\": " << nodes << ", \"iterations\": " << iterations;
+            std::cout << ", \"seconds\": " << seconds << ", \"nodes_per_second\": " << throughput;
+            std::cout << "}" << std::endl;
+        } else {
+            std::cout << scenario << "," << operation << "," << nodes << "," << iterations;
+            std::cout << "," << seconds << "," << throughput << std::endl;
+        }
+    }
+
+};
+
+/**
+ * Runs all benchmarks for trees generated by the given function.
+ */
+static void run_scenario(
+    Runner &runner,
+    const std::string &scenario,
+    const std::function<bench::One<bench::Root>()> &generate
+) {
+    auto tree = generate();
+    Summer counter;
+    tree->visit(counter);
+    size_t nodes = counter.count;
+
+    // Used to make sure the compiler doesn't optimize anything away.
+    size_t sink = 0;
+
+    runner.run(scenario, "construct", nodes, [&]() {
+        sink += generate()->items.size();
+    });
+    runner.run(scenario, "clone", nodes, [&]() {
+        sink += tree.clone()->items.size();
+    });
+    auto clone = tree.clone();
+    runner.run(scenario, "equals", nodes, [&]() {
+        sink += tree.equals(clone);
+    });
+    runner.run(scenario, "check_well_formed", nodes, [&]() {
+        tree.check_well_formed();
+    });
+    runner.run(scenario, "visit", nodes, [&]() {
+        Summer summer;
+        tree->visit(summer);
+        sink += summer.sum;
+    });
+    std::string cbor;
+    runner.run(scenario, "serialize", nodes, [&]() {
+        cbor = tree::base::serialize(tree);
+    });
+    runner.run(scenario, "deserialize", nodes, [&]() {
+        sink += tree::base::deserialize<bench::Root>(cbor)->items.size();
+    });
+    runner.run(scenario, "dump", nodes, [&]() {
+        std::ostringstream ss{};
+        tree->dump(ss);
+        sink += ss.str().size();
+    });
+
+    if (sink == 42) {
+        std::cerr << std::endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t scale = 1;
+    double min_time = 0.5;
+    bool json = false;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--json")) {
+            json = true;
+        } else if (!std::strcmp(argv[i], "--scale") && i + 1 < argc) {
+            scale = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            min_time = std::strtod(argv[++i], nullptr);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--json] [--scale N] [--min-time SECONDS]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Register the annotation types, so they are included in the
+    // serialization benchmarks.
+    tree::annotatable::serdes_registry.add<primitives::Note<0>>("note0");
+    tree::annotatable::serdes_registry.add<primitives::Note<1>>("note1");
+    tree::annotatable::serdes_registry.add<primitives::Note<2>>("note2");
+    tree::annotatable::serdes_registry.add<primitives::Note<3>>("note3");
+
+    Runner runner{min_time, json};
+    run_scenario(runner, "deep_chain", [scale]() {
+        return Generator(1).deep_chain(500 * scale);
+    });
+    run_scenario(runner, "wide_list", [scale]() {
+        return Generator(2).wide_list(10000 * scale);
+    });
+    run_scenario(runner, "link_heavy", [scale]() {
+        return Generator(3).link_heavy(5000 * scale);
+    });
+    run_scenario(runner, "annotation_heavy", [scale]() {
+        return Generator(4).annotation_heavy(5000 * scale);
+    });
+    run_scenario(runner, "random", [scale]() {
+        return Generator(5).random_tree(10000 * scale);
+    });
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+/** \file
+ * Defines primitives used in the generated benchmark tree structure.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "tree-cbor.hpp"
+
+/**
+ * Namespace with primitives used in the generated benchmark tree structure.
+ */
+namespace primitives {
+
+/**
+ * Integer primitive.
+ */
+using Int = int64_t;
+
+/**
+ * String primitive.
+ */
+using Str = std::string;
+
+/**
+ * Initialization function. This must be specialized for any types used as
+ * primitives in a tree that are actual C primitives (int, char, bool, etc),
+ * as these are not initialized by the T() construct.
+ */
+template <class T>
+T initialize() { return T(); };
+
+/**
+ * Declare the default initializer for integers.
+ */
+template <>
+inline Int initialize<Int>() {
+    return 0;
+}
+
+/**
+ * Serialization function. This must be specialized for any types used as
+ * primitives in a tree. The default implementation doesn't do anything.
+ */
+template <typename T>
+void serialize(const T &obj, tree::cbor::MapWriter &map) {
+}
+
+/**
+ * Serialization function for Int.
+ */
+template <>
+inline void serialize<Int>(const Int &obj, tree::cbor::MapWriter &map) {
+    map.append_int("val", obj);
+}
+
+/**
+ * Serialization function for Str.
+ */
+template <>
+inline void serialize<Str>(const Str &obj, tree::cbor::MapWriter &map) {
+    map.append_string("val", obj);
+}
+
+/**
+ * Deserialization function. This must be specialized for any types used as
+ * primitives in a tree. The default implementation doesn't do anything.
+ */
+template <typename T>
+T deserialize(const tree::cbor::MapReader &map) {
+    return initialize<T>();
+}
+
+/**
+ * Deserialization function for Int.
+ */
+template <>
+inline Int deserialize<Int>(const tree::cbor::MapReader &map) {
+    return map.at("val").as_int();
+}
+
+/**
+ * Deserialization function for Str.
+ */
+template <>
+inline Str deserialize<Str>(const tree::cbor::MapReader &map) {
+    return map.at("val").as_string();
+}
+
+/**
+ * Annotation type for the annotation-heavy benchmark. The template parameter
+ * only serves to make distinct types, since a node can only carry one
+ * annotation of each type.
+ */
+template <int N>
+class Note {
+public:
+
+    /**
+     * The annotation payload.
+     */
+    Int value;
+
+    /**
+     * Constructs a note with the given value.
+     */
+    explicit Note(Int value) : value(value) {}
+
+    /**
+     * Deserializes a note.
+     */
+    explicit Note(const tree::cbor::MapReader &map) : value(map.at("val").as_int()) {}
+
+    /**
+     * Serializes a note.
+     */
+    void serialize(tree::cbor::MapWriter &map) const {
+        map.append_int("val", value);
+    }
+
+};
+
+} // namespace primitives
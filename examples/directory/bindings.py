@@ -0,0 +1,109 @@
+import sys, os
+TEST_DIR = os.path.realpath(sys.argv[1])
+sys.path.append(TEST_DIR)
+
+# Tests the directory_native extension module generated using
+# --python-bindings, which exposes the C++ tree to Python without converting
+# it. The results are checked against the pure-Python directory module.
+import directory
+import directory_native as native
+
+with open(os.path.join(TEST_DIR, 'tree.cbor'), 'rb') as f:
+    cbor = f.read()
+
+# Loading the tree through the bindings gives the same tree as loading it in
+# pure Python.
+tree = native.deserialize(cbor)
+ref = directory.System.deserialize(cbor)
+assert isinstance(tree, native.System)
+assert isinstance(tree, native.Node)
+tree.check_well_formed()
+assert tree.to_python().serialize() == ref.serialize()
+assert native.from_python(ref).serialize() == tree.serialize()
+
+# Field access mirrors the pure-Python classes, including the primitive types.
+drive = tree.drives[0]
+assert len(tree.drives) == len(ref.drives)
+assert isinstance(drive.letter, directory.primitives.Letter)
+assert drive.letter == ref.drives[0].letter
+assert [e.name for e in drive.root_dir.entries] == [e.name for e in ref.drives[0].root_dir.entries]
+
+# Modifications are made directly to the C++ tree. Apply the same ones to the
+# pure-Python tree and check that both trees still agree.
+for t, m in ((tree, native), (ref, directory)):
+    root = t.drives[0].root_dir
+    root.entries.append(m.File(name='new.txt', contents='hello'))
+    root.entries.insert(0, m.Directory(name='empty'))
+    t.drives.append(m.Drive(letter='D', root_dir=m.Directory(entries=[
+        m.File(name='a', contents='1'),
+        m.Mount(name='link', target=root),
+    ])))
+    t.drives[0].letter = 'E'
+    root.entries[1].name = 'renamed'
+    del root.entries[2]
+assert tree.to_python().serialize() == ref.serialize()
+tree.check_well_formed()
+
+# Links point to the same C++ node, even though every attribute access returns
+# a new proxy object.
+mount = tree.drives[-1].root_dir.entries[1]
+assert mount.target == tree.drives[0].root_dir
+mount.target.name = 'root'
+assert tree.drives[0].root_dir.name == 'root'
+
+# Type errors are reported like in the pure-Python module.
+for action in (
+    lambda: setattr(tree.drives[0], 'root_dir', native.File()),
+    lambda: tree.drives.append('not-a-drive'),
+    lambda: native.File(name=native.File()),
+    lambda: native.Entry(),
+):
+    try:
+        action()
+    except TypeError:
+        pass
+    else:
+        assert False
+
+# One edges may be emptied, making the tree not well-formed.
+tree.drives[-1].root_dir = None
+assert not tree.is_well_formed()
+try:
+    tree.serialize()
+except native.NotWellFormed:
+    pass
+else:
+    assert False
+tree.drives.pop()
+tree.check_well_formed()
+
+# Annotations are stored in the C++ nodes, so they outlive the proxy.
+tree.drives[0]['note'] = [1, 2, 3]
+assert 'note' in tree.drives[0]
+assert tree.drives[0]['note'] == [1, 2, 3]
+del tree.drives[0]['note']
+assert 'note' not in tree.drives[0]
+
+# visit() walks the tree in pre-order without converting it.
+names = []
+tree.visit(lambda node: names.append(type(node).__name__))
+entries = tree.drives[0].root_dir.entries
+assert names[:5] == ['System', 'Drive', 'Directory'] + [type(entries[0]).__name__, type(entries[1]).__name__]
+assert len(names) == len(tree.to_python().find_reachable())
+count = [0]
+def count_nodes(node):
+    count[0] += 1
+    return not isinstance(node, native.Drive)
+tree.visit(count_nodes)
+assert count[0] == 1 + len(tree.drives)
+
+# Clones are independent of the original. Note that links are compared by
+# identity, and are not redirected by clone().
+original = native.Directory(name='x', entries=[native.File(name='y')])
+copy = original.clone()
+assert copy == original
+copy.entries[0].contents = 'z'
+assert copy != original
+assert tree == tree and tree != tree.drives[0]
+
+print('ok')
@@ -6,6 +6,39 @@
 // Include the generated file.
 #include "directory.hpp"
 
+// Generic algorithm used near the end of main(): gathers statistics about a
+// tree using the generated compile-time reflection information.
+struct Statistics {
+    size_t nodes = 0;
+    size_t children = 0;
+    size_t links = 0;
+    size_t primitives = 0;
+
+    // Called by for_each_node() for each node.
+    template <class T>
+    void operator()(T &node) {
+        nodes++;
+        directory::NodeTraits<T>::for_each_field(node, *this);
+    }
+
+    // Called by for_each_field() for each field.
+    template <class T>
+    void operator()(const char*, const T&) {
+        switch (tree::base::field_kind<T>::value) {
+            case tree::base::FieldKind::PRIMITIVE:
+                primitives++;
+                break;
+            case tree::base::FieldKind::LINK:
+            case tree::base::FieldKind::OPT_LINK:
+                links++;
+                break;
+            default:
+                children++;
+                break;
+        }
+    }
+};
+
 // Note: the // comment contents of main(), together with the MARKER lines and
 // the output of the program, are used to automatically turn this into a
 // restructured-text page for ReadTheDocs.
@@ -271,5 +304,183 @@ int main() {
     ASSERT(ss1.str() == ss2.str());
     MARKER
 
+    // Serialized trees are very repetitive, so when you store a lot of them it
+    // pays off to compress them. serialize_compressed() does that using a
+    // small built-in block compressor and a preset dictionary derived from the
+    // tree description. deserialize() detects compressed data automatically.
+    // serialize_file() and deserialize_file() can do the same for files.
+    std::string compressed = tree::base::serialize_compressed(system);
+    std::cout << cbor.size() << " bytes -> " << compressed.size() << " bytes" << std::endl;
+    ASSERT(compressed.size() < cbor.size());
+    auto system3 = tree::base::deserialize<directory::System>(compressed);
+    ASSERT(tree::base::serialize(system3) == cbor);
+    MARKER
+
+    // When serialized trees are only ever read back by the same program, for
+    // instance in a cache, serialize_checked() can be used to protect them
+    // with a CRC32C checksum and a fingerprint of the tree description.
+    // deserialize_trusted() verifies the checksum and then skips validating
+    // the tree, since it was already validated when it was written. A
+    // checksum doesn't protect against tampering though, so deserialize()
+    // always validates the tree, also for checksummed data.
+    std::string checked = tree::base::serialize_checked(system);
+    auto system4 = tree::base::deserialize_trusted<directory::System>(checked);
+    ASSERT(tree::base::serialize(system4) == cbor);
+    ASSERT(tree::base::serialize(tree::base::deserialize<directory::System>(checked)) == cbor);
+    checked[checked.size() / 2] ^= 1;
+    ASSERT_RAISES(std::runtime_error, tree::base::deserialize_trusted<directory::System>(checked));
+    MARKER
+
+    // To use trees as cache keys, we need a representation that only depends
+    // on what's in the tree. serialize_canonical() provides that, and
+    // content_hash() derives a SHA-256 hash from it, built up from the hashes
+    // of the subtrees. Our deserialized copy has the same hash as the
+    // original, even though the two don't compare equal because of the links.
+    std::string hash = tree::base::content_hash(system);
+    std::cout << hash << std::endl;
+    ASSERT(tree::base::content_hash(system2) == hash);
+    system2->drives[0]->letter = 'D';
+    ASSERT(tree::base::content_hash(system2) != hash);
+    MARKER
+
+    // A ContentStore keeps serialized trees in a directory, in files named
+    // after their content hash. Storing the same tree twice only writes it
+    // once.
+    tree::base::ContentStore store{"."};
+    ASSERT(store.put(system) == hash);
+    ASSERT(store.contains(hash));
+    ASSERT(!store.put_data(hash, store.get_data(hash)));
+    auto system5 = store.get<directory::System>(hash);
+    ASSERT(tree::base::serialize(system5) == cbor);
+    std::remove((hash + ".cbor").c_str());
+    MARKER
+
+    // The hash of a subtree only depends on the subtree itself, as long as
+    // its links point into it. HashIndex computes the hashes of all nodes in
+    // a tree in one go, and the ContentStore can store such subtrees under
+    // that same hash. Let's make a directory with a mount of its own
+    // subdirectory, and add it to the C: drive.
+    auto sub_dir = tree::base::make<directory::Directory>(
+        tree::base::Any<directory::Entry>{},
+        "sub");
+    auto own_dir = tree::base::make<directory::Directory>(
+        tree::base::Any<directory::Entry>{},
+        "own");
+    own_dir->entries.add(sub_dir);
+    own_dir->entries.emplace<directory::Mount>(sub_dir, "shortcut");
+    std::string own_hash = tree::base::content_hash(own_dir);
+    system->drives[0]->root_dir->entries.add(own_dir);
+    tree::base::HashIndex index{system};
+    ASSERT(index.get(system) == tree::base::content_hash(system));
+    ASSERT(index.get(own_dir) == own_hash);
+    ASSERT(index.get(sub_dir) == tree::base::content_hash(sub_dir));
+    ASSERT(index.get(sub_dir) != own_hash);
+    ASSERT(store.put(own_dir) == own_hash);
+    auto own_dir2 = store.get<directory::Directory>(own_hash);
+    ASSERT(tree::base::content_hash(own_dir2) == own_hash);
+    ASSERT(own_dir2->entries[1]->as_mount()->target.links_to(own_dir2->entries[0]));
+    std::remove((own_hash + ".cbor").c_str());
+    system->drives[0]->root_dir->entries.remove();
+    MARKER
+
+    // If (de)serialization is slow, serialize_with_stats() and
+    // deserialize_with_stats() report where the time goes: node and byte
+    // counts, allocations, and the time spent in each phase. The counters
+    // are compiled out unless the support library and generated code are
+    // built with TREE_STATS set to 1, for instance using the TREE_GEN_STATS
+    // CMake option; otherwise they remain zero. tree::stats::set_hook() can be used to receive these statistics
+    // for every instrumented operation.
+    tree::stats::Stats stats{};
+    auto system6 = tree::base::deserialize_with_stats<directory::System>(
+        tree::base::serialize_with_stats(system, stats), stats);
+    std::cout << "nodes visited: " << stats.nodes_visited << std::endl;
+    ASSERT(tree::base::serialize(system6) == cbor);
+    ASSERT(stats.nodes_visited == 0 || tree::stats::ENABLED);
+    MARKER
+
+    // To find out where memory goes, memory_usage() accounts for the nodes,
+    // edges, primitives, and annotations in a tree, grouped by type. The
+    // heap memory of the primitives is determined using the function
+    // specified with the heap_size_function directive.
+    auto usage = tree::base::memory_usage(system);
+    usage.dump();
+    ASSERT(usage.node_types.at("File").count == 3);
+    ASSERT(usage.total().total() > 0);
+    MARKER
+
+    // When many independent trees need to be deserialized, modified, and
+    // serialized again, process_batch() spreads the work over a pool of
+    // threads. The transformation function is called concurrently for
+    // different trees, so it must not touch shared state. The results are
+    // returned in the same order as the inputs. process_stream() does the
+    // same for trees that are read from and written to elsewhere, only
+    // loading inputs when a thread is ready for them.
+    std::vector<std::string> batch(8, cbor);
+    tree::base::BatchOptions batch_options{};
+    batch_options.threads = 4;
+    auto results = tree::base::process_batch<directory::System>(
+        batch, [](tree::base::Maybe<directory::System> &tree) {
+            tree->drives[0]->letter = 'Z';
+        }, batch_options);
+    ASSERT(results.size() == 8);
+    ASSERT(tree::base::deserialize<directory::System>(results[7])->drives[0]->letter == 'Z');
+    MARKER
+
+    // tree-gen also generates compile-time reflection information for each
+    // node type in the form of NodeTraits specializations, along with
+    // dispatch() and for_each_node(). This allows generic algorithms to be
+    // written once as a template (see the Statistics functor at the top of
+    // this file) while still being specialized for each node type by the
+    // compiler, without virtual calls.
+    std::cout << directory::NodeTraits<directory::Drive>::name() << " has ";
+    std::cout << directory::NodeTraits<directory::Drive>::FIELD_COUNT << " fields" << std::endl;
+    ASSERT(directory::NodeTraits<directory::Entry>::contains(directory::NodeType::Mount));
+    ASSERT(!directory::NodeTraits<directory::Entry>::IS_LEAF);
+    Statistics statistics{};
+    directory::for_each_node(*system, statistics);
+    std::cout << statistics.nodes << " nodes, " << statistics.children << " child edges, ";
+    std::cout << statistics.links << " links, " << statistics.primitives << " primitives" << std::endl;
+    ASSERT(statistics.nodes == 13);
+    ASSERT(statistics.links == 2);
+    MARKER
+
+    // tree-gen also analyzes which node types can contain links, error
+    // markers, or edges that may be empty. Completeness checks skip subtrees
+    // that can't contain any of these, and because a File can't contain
+    // links, serializing one doesn't need to find all the reachable nodes
+    // first.
+    ASSERT(directory::System::MAY_CONTAIN_LINKS);
+    ASSERT(!directory::File::MAY_CONTAIN_LINKS);
+    auto file = tree::base::make<directory::File>("hello", "readme.txt");
+    auto file_copy = tree::base::deserialize<directory::File>(tree::base::serialize(file));
+    ASSERT(file_copy.equals(file));
+    MARKER
+
+    // Entry names use the interned string type from the support library (see
+    // primitives.hpp and directory.tree). Each distinct name is stored only
+    // once, comparing two names only compares their identifiers, and a
+    // serialized tree contains each distinct name only once.
+    ASSERT(root->entries[4]->name == "pagefile.sys");
+    ASSERT(root->entries[4]->name == primitives::Name("pagefile.sys"));
+    ASSERT(root->entries[4]->name.id() == primitives::Name("pagefile.sys").id());
+    MARKER
+
+    // Because directory.tree uses the compact_location directive, every node
+    // has a slot for a source location, packed into 64 bits with the file
+    // name stored once in a process-wide table. The dumper prints locations
+    // after the node type, and serialization writes the locations of all
+    // nodes as a single delta-encoded column at the end of the root node.
+    system->set_location({"system.txt", 1, 1});
+    system->drives[0]->set_location({"system.txt", 2, 5, 3});
+    root->entries[4]->set_location({"system.txt", 7, 9, 12});
+    system->dump();
+    auto system7 = tree::base::deserialize<directory::System>(tree::base::serialize(system));
+    ASSERT(system7->get_location() == system->get_location());
+    ASSERT(system7->drives[0]->get_location().line() == 2);
+    ASSERT(system7->drives[0]->get_location().span() == 3);
+    ASSERT(system7->drives[0]->root_dir->entries[4]->get_location().filename() == "system.txt");
+    ASSERT(!system7->drives[0]->root_dir->get_location());
+    MARKER
+
     return 0;
 }
@@ -101,3 +101,50 @@ for c in cbor:
     count += 1
 print()
 marker()
+
+# | The conversion between CBOR and Python objects is done in pure Python,
+# | unless the optional tree_gen_cbor extension module can be imported (build
+# | it by setting the TREE_GEN_BUILD_PYTHON_CBOR CMake option). It is much
+# | faster for large trees, but otherwise behaves the same.
+import directory
+native = directory._native_cbor
+directory._native_cbor = None
+try:
+    assert System.deserialize(cbor).serialize() == cbor
+
+    # | In that case, deserialize() decodes the CBOR bytes into nodes
+    # | directly. Input known to come from a tree-gen serializer can be loaded
+    # | with trusted=True, which skips the type checks of the field setters.
+    assert System.deserialize(memoryview(cbor), trusted=True).serialize() == cbor
+finally:
+    directory._native_cbor = native
+
+# | The traversals done by the generated Python classes (serialization,
+# | deserialization, cloning, well-formedness checks and debug dumps) keep
+# | their state on an explicit stack rather than recursing, so trees may be
+# | nested much deeper than Python's recursion limit.
+deep = Directory(name='deep')
+leaf = deep
+for _ in range(3 * sys.getrecursionlimit()):
+    leaf.entries.append(Directory(name='sub'))
+    leaf = leaf.entries[0]
+leaf.entries.append(Mount(deep, 'up'))
+deep = System([Drive('D', deep)])
+deep.check_well_formed()
+assert System.deserialize(deep.serialize()).serialize() == deep.serialize()
+assert deep.clone() == deep
+assert len(deep.dump().splitlines()) > 3 * sys.getrecursionlimit()
+
+# | The same goes for the Python representation of CBOR objects, in which the
+# | C++ code refers to interned strings through a string table (@S).
+def directory_rep(seq):
+    return {'@T': '1', '@i': seq, '@t': 'Directory',
+            'entries': {'@T': '*', '@d': []}, 'name': {'val': {'@r': 0}}}
+rep = leaf = directory_rep(0)
+for seq in range(1, 3 * sys.getrecursionlimit()):
+    leaf['entries']['@d'].append(directory_rep(seq))
+    leaf = leaf['entries']['@d'][0]
+rep['@S'] = ['sub']
+deep_dir = Directory.deserialize(rep)
+assert deep_dir.name == 'sub' and deep_dir.entries[0].name == 'sub'
+assert rep['name'] == {'val': {'@r': 0}}
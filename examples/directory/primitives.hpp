@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string>
+#include <cstddef>
 
 /**
  * Namespace with primitives used in the generated directory tree structure.
@@ -17,10 +18,17 @@ namespace primitives {
 using Letter = char;
 
 /**
- * Strings, used to represent filenames and file contents.
+ * Strings, used to represent file contents.
  */
 using String = std::string;
 
+/**
+ * Interned strings, used to represent filenames. Filenames are often
+ * repeated, so they are only stored once. This also makes comparing them
+ * cheap.
+ */
+using Name = tree::intern::String;
+
 /**
  * Initialization function. This must be specialized for any types used as
  * primitives in a tree that are actual C primitives (int, char, bool, etc),
@@ -62,6 +70,15 @@ inline void serialize<String>(const String &obj, tree::cbor::MapWriter &map) {
     map.append_string("val", obj);
 }
 
+/**
+ * Serialization function for Name. Within a serialized tree, each distinct
+ * name is only written once.
+ */
+template <>
+inline void serialize<Name>(const Name &obj, tree::cbor::MapWriter &map) {
+    tree::intern::serialize(obj, map, "val");
+}
+
 /**
  * Deserialization function. This must be specialized for any types used as
  * primitives in a tree. The default implementation doesn't do anything.
@@ -87,4 +104,36 @@ inline String deserialize<String>(const tree::cbor::MapReader &map) {
     return map.at("val").as_string();
 }
 
+/**
+ * Deserialization function for Name.
+ */
+template <>
+inline Name deserialize<Name>(const tree::cbor::MapReader &map) {
+    return tree::intern::deserialize(map.at("val"));
+}
+
+/**
+ * Heap size function, used for memory usage reports. This must be specialized
+ * for any types used as primitives in a tree that allocate memory on the
+ * heap. The default implementation returns zero.
+ */
+template <typename T>
+size_t heap_size(const T &) {
+    return 0;
+}
+
+/**
+ * Heap size function for String. Short strings are stored inside the string
+ * object itself, in which case no heap memory is used.
+ */
+template <>
+inline size_t heap_size<String>(const String &obj) {
+    auto data = reinterpret_cast<const char*>(obj.data());
+    auto self = reinterpret_cast<const char*>(&obj);
+    if (data >= self && data < self + sizeof(String)) {
+        return 0;
+    }
+    return obj.capacity() + 1;
+}
+
 } // namespace primitives
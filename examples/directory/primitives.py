@@ -6,7 +6,13 @@ class Letter(str):
 
 
 class String(str):
-    """Strings, used to represent filenames and file contents."""
+    """Strings, used to represent file contents."""
+    pass
+
+
+class Name(str):
+    """Filenames. These are interned strings in C++, but that makes no
+    difference here."""
     pass
 
 
@@ -18,6 +24,8 @@ def serialize(typ, val):
         return {'val': ord(val)}
     if typ is String:
         return {'val': val}
+    if typ is Name:
+        return {'val': val}
 
     # Serialization formats of annotations.
     if isinstance(typ, str):
@@ -35,6 +43,8 @@ def deserialize(typ, val):
         return Letter(chr(val['val']))
     if typ is String:
         return String(val['val'])
+    if typ is Name:
+        return Name(val['val'])
 
     # Serialization formats of annotations.
     if isinstance(typ, str):
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cstdio>
 #include <stdexcept>
+#include <algorithm>
 #include "../utils.hpp"
 
 // Include the generated files.
@@ -272,7 +273,7 @@ int main() {
     // Let's look at what an expression evaluator looks like for this.
     class RvalueEvaluator : public value::Visitor<int> {
     public:
-        int visit_node(value::Node &node) override {
+        int visit_node(value::Node &) override {
             throw std::runtime_error("unknown node type");
         }
 
@@ -334,5 +335,192 @@ int main() {
     // pattern and casts is therefore usually a matter of personal preference.
     MARKER
 
+    // Analyses such as type inference or constant folding often end up
+    // asking for the same result over and over again, for instance because
+    // many places link to the same node. Rather than maintaining a map from
+    // nodes to results by hand, you can derive from ``MemoVisitor<T>``
+    // instead of ``Visitor<T>``. It works the same way, but caches the result
+    // for every node it visits, so visiting the same node again returns the
+    // cached result without calling your visit function.
+    class MemoEvaluator : public value::MemoVisitor<int> {
+    public:
+        int evaluations = 0;
+
+        int visit_node(value::Node &) override {
+            throw std::runtime_error("unknown node type");
+        }
+
+        int visit_literal(value::Literal &node) override {
+            evaluations++;
+            return node.value;
+        }
+
+        int visit_mul(value::Mul &node) override {
+            evaluations++;
+            return node.lhs->visit(*this) * node.rhs->visit(*this);
+        }
+
+        int visit_add(value::Add &node) override {
+            evaluations++;
+            return node.lhs->visit(*this) + node.rhs->visit(*this);
+        }
+    };
+    MemoEvaluator memo{};
+    ASSERT(expr->visit(memo) == 14);
+    ASSERT(memo.evaluations == 5);
+    ASSERT(expr->visit(memo) == 14);
+    ASSERT(memo.evaluations == 5);
+    ASSERT(memo.hits() == 1);
+    MARKER
+
+    // The cache does not notice when the tree is modified. After changing a
+    // node, you have to invalidate the cached result of that node and of
+    // every node that depends on it yourself, or clear the cache entirely.
+    expr->lhs->as_literal()->value = 3;
+    memo.invalidate(*expr->lhs);
+    memo.invalidate(*expr);
+    ASSERT(expr->visit(memo) == 15);
+    ASSERT(memo.evaluations == 7);
+    memo.clear();
+    ASSERT(!memo.is_cached(*expr));
+    MARKER
+
+    // When many passes are run over the same tree, traversing the tree for
+    // each of them separately gets expensive. The generated ``PassManager``
+    // fuses visitor passes into as few traversals as possible. Such visitor
+    // passes only handle the node they are called for; the pass manager
+    // recurses into the children for them. Each pass also declares which
+    // annotation types it reads and writes, so the pass manager knows which
+    // passes may share a traversal: a pass that reads an annotation written
+    // by an earlier pass must wait for that pass to finish.
+    struct Depth {
+        int value;
+    };
+    class LiteralCounter : public value::Visitor<void> {
+    public:
+        int count = 0;
+        void visit_node(value::Node &) override {}
+        void visit_literal(value::Literal &) override {
+            count++;
+        }
+    };
+    class DepthAnnotator : public value::Visitor<void> {
+    public:
+        void visit_node(value::Node &) override {}
+        void visit_binop(value::Binop &node) override {
+            int depth = node.get_annotation<Depth>().value + 1;
+            node.lhs->set_annotation(Depth{depth});
+            node.rhs->set_annotation(Depth{depth});
+        }
+    };
+    class DepthChecker : public value::Visitor<void> {
+    public:
+        int max_depth = 0;
+        void visit_node(value::Node &node) override {
+            max_depth = std::max(max_depth, node.get_annotation<Depth>().value);
+        }
+    };
+    LiteralCounter literals{};
+    DepthAnnotator annotator{};
+    DepthChecker checker{};
+    value::PassManager passes{};
+    passes.add_function("init", [](value::Node &root) {
+        root.set_annotation(Depth{0});
+    }, {}, {typeid(Depth)});
+    passes.add_visitor("literals", literals);
+    passes.add_visitor("depth", annotator, {typeid(Depth)}, {typeid(Depth)});
+    passes.add_visitor("check", checker, {typeid(Depth)});
+    auto stages = passes.get_stages();
+    ASSERT(stages.size() == 3);
+    ASSERT(stages[0].size() == 2);
+    passes.run(*expr);
+    ASSERT(literals.count == 3);
+    ASSERT(checker.max_depth == 2);
+    MARKER
+
+    // Node layout
+    // ===========
+    //
+    // Fields that are rarely set, such as the comment attached to a
+    // statement in ``program.tree``, can be marked ``cold``. Such fields are
+    // stored as a ``Cold<T>``, which only holds a pointer and allocates the
+    // value on the heap when it's set to something other than the default.
+    // Values are read using ``get()`` and written by assigning to the field.
+    // The ``optimize_layout`` directive additionally sorts the members of
+    // the generated classes by alignment, to minimize padding.
+    auto print = tree::base::make<program::Print>();
+    ASSERT(print->comment.get().empty());
+    ASSERT(!print->comment.is_allocated());
+    print->comment = "debugging aid";
+    ASSERT(print->comment.is_allocated());
+    auto print_copy = print.clone();
+    ASSERT(print_copy.equals(print));
+    std::cout << "comment: " << print_copy->as_print()->comment.get() << std::endl;
+    ASSERT(sizeof(tree::base::Cold<primitives::Str>) < sizeof(primitives::Str));
+    MARKER
+
+    // Edges declared as ``Inline`` instead of ``One``, such as the range of
+    // a for loop, store the child node by value inside the parent. This
+    // avoids a heap allocation and a pointer indirection, but only works for
+    // leaf node types, and the child can't be the target of a link. Apart
+    // from that, they are used like ``One`` edges, and they serialize the
+    // same way.
+    auto var = tree::base::make<value::Variable>("i");
+    auto loop = tree::base::make<program::ForLoop>();
+    loop->var = tree::base::make<value::Reference>("i", var);
+    loop->range->start = tree::base::make<value::Literal>(0);
+    loop->range->stop = tree::base::make<value::Literal>(10);
+    auto prog = tree::base::make<program::Program>();
+    prog->variables.add(var);
+    prog->statements.add(loop);
+    ASSERT(prog.is_well_formed());
+    auto prog_copy = tree::base::deserialize<program::Program>(tree::base::serialize(prog));
+    ASSERT(prog_copy->statements[0]->as_for_loop()->range->stop->as_literal()->value == 10);
+    prog_copy->dump();
+    MARKER
+
+    // Node types without any fields, such as Input, can't hold any
+    // information other than their type and annotations. Instead of
+    // allocating a new node each time, you can use the shared instance
+    // returned by ``shared()``. Unlike other nodes, shared instances may
+    // appear any number of times in a tree, and they are serialized without
+    // a sequence number, such that deserialization returns the shared
+    // instance again. Shared instances must not be modified (so also no
+    // annotations) and can't be the target of a link. Copies of a shared
+    // instance are ordinary nodes.
+    auto inputs = tree::base::make<program::Program>();
+    inputs->variables.add(tree::base::make<value::Variable>("x"));
+    for (int i = 0; i < 2; i++) {
+        auto asgn = tree::base::make<program::Assignment>();
+        asgn->lhs = tree::base::make<value::Reference>("x", inputs->variables[0]);
+        asgn->rhs = value::Input::shared();
+        inputs->statements.add(asgn);
+    }
+    auto rhs0 = inputs->statements[0]->as_assignment()->rhs.get_ptr();
+    auto rhs1 = inputs->statements[1]->as_assignment()->rhs.get_ptr();
+    ASSERT(rhs0 == rhs1);
+    tree::base::PointerMap reachable{};
+    inputs.find_reachable(reachable);
+    ASSERT(inputs.is_well_formed());
+    auto inputs_copy = tree::base::deserialize<program::Program>(tree::base::serialize(inputs));
+    auto &rhs_copy = inputs_copy->statements[1]->as_assignment()->rhs;
+    ASSERT(rhs_copy->is_shared());
+    ASSERT(rhs_copy.get_ptr() == value::Input::shared().get_ptr());
+    ASSERT(!inputs->statements[0]->as_assignment()->rhs.clone()->is_shared());
+    MARKER
+
+    // Only shared instances may lack a sequence number, though; for any
+    // other node, a missing sequence number means that the data is corrupt.
+    auto sum = tree::base::make<value::Add>(
+        tree::base::make<value::Literal>(1),
+        value::Input::shared());
+    auto sum_cbor = tree::base::serialize(sum);
+    ASSERT(tree::base::deserialize<value::Rvalue>(sum_cbor)->as_add()->rhs->is_shared());
+    for (size_t pos = sum_cbor.find("\x62@i"); pos != std::string::npos; pos = sum_cbor.find("\x62@i", pos)) {
+        sum_cbor[pos + 2] = 'x';
+    }
+    ASSERT_RAISES(std::runtime_error, tree::base::deserialize<value::Rvalue>(sum_cbor));
+    MARKER
+
     return 0;
 }
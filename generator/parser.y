@@ -67,11 +67,11 @@
 /* Tokens */
 %token <str> DOCSTRING
 %token <str> INCLUDE SRC_INCLUDE PY_INCLUDE
-%token SOURCE HEADER PYTHON TREE_NS SUPPORT_NS INIT_FN SERDES_FNS SOURCE_LOC
+%token SOURCE HEADER PYTHON TREE_NS SUPPORT_NS INIT_FN SERDES_FNS SOURCE_LOC HEAP_SIZE_FN OPT_LAYOUT COMPACT_LOC
 %token NAMESPACE NAMESPACE_SEP
 %token ERROR
-%token MAYBE ONE ANY MANY OLINK LINK EXT
-%token REORDER
+%token MAYBE ONE INLINE ANY MANY OLINK LINK EXT
+%token REORDER COLD
 %token <str> IDENT STRING
 %token '{' '}' '(' ')' '<' '>' ':' ';'
 %token BAD_CHARACTER
@@ -101,6 +101,7 @@ Node            : Documentation IDENT '{'
                 | Node ERROR ';'                                                { TRY $$ = $1->mark_error(); CATCH }
                 | Node Documentation IDENT ':' MAYBE '<' Identifier '>' ';'     { TRY $$ = $1->with_child(tree_gen::Maybe, *$7, std::string($3), *$2); delete $2; std::free($3); delete $7; CATCH }
                 | Node Documentation IDENT ':' ONE '<' Identifier '>' ';'       { TRY $$ = $1->with_child(tree_gen::One, *$7, std::string($3), *$2); delete $2; std::free($3); delete $7; CATCH }
+                | Node Documentation IDENT ':' INLINE '<' Identifier '>' ';'    { TRY $$ = $1->with_child(tree_gen::One, *$7, std::string($3), *$2, true); delete $2; std::free($3); delete $7; CATCH }
                 | Node Documentation IDENT ':' ANY '<' Identifier '>' ';'       { TRY $$ = $1->with_child(tree_gen::Any, *$7, std::string($3), *$2); delete $2; std::free($3); delete $7; CATCH }
                 | Node Documentation IDENT ':' MANY '<' Identifier '>' ';'      { TRY $$ = $1->with_child(tree_gen::Many, *$7, std::string($3), *$2); delete $2; std::free($3); delete $7; CATCH }
                 | Node Documentation IDENT ':' OLINK '<' Identifier '>' ';'     { TRY $$ = $1->with_child(tree_gen::OptLink, *$7, std::string($3), *$2); delete $2; std::free($3); delete $7; CATCH }
@@ -112,6 +113,7 @@ Node            : Documentation IDENT '{'
                 | Node Documentation IDENT ':' EXT OLINK '<' Identifier '>' ';' { TRY $$ = $1->with_prim(*$8, std::string($3), *$2, tree_gen::OptLink); delete $2; std::free($3); delete $8; CATCH }
                 | Node Documentation IDENT ':' EXT LINK '<' Identifier '>' ';'  { TRY $$ = $1->with_prim(*$8, std::string($3), *$2, tree_gen::Link); delete $2; std::free($3); delete $8; CATCH }
                 | Node Documentation IDENT ':' Identifier ';'                   { TRY $$ = $1->with_prim(*$5, std::string($3), *$2, tree_gen::Prim); delete $2; std::free($3); delete $5; CATCH }
+                | Node Documentation COLD IDENT ':' Identifier ';'              { TRY $$ = $1->with_prim(*$6, std::string($4), *$2, tree_gen::Prim, true); delete $2; std::free($4); delete $6; CATCH }
                 | Node Documentation REORDER '(' Identifiers ')' ';'            { TRY $$ = $1->with_order(std::move(*$5)); delete $2; delete $5; CATCH }
                 | Node Node '}'                                                 { TRY $2->derive_from($1->node); CATCH }
                 ;
@@ -126,6 +128,9 @@ Root            :
                 | Root INIT_FN Identifier                                       { TRY specification.set_initialize_function(*$3); delete $3; CATCH }
                 | Root SERDES_FNS Identifier Identifier                         { TRY specification.set_serdes_functions(*$3, *$4); delete $3; delete $4; CATCH }
                 | Root SOURCE_LOC Identifier                                    { TRY specification.set_source_location(*$3); delete $3; CATCH }
+                | Root HEAP_SIZE_FN Identifier                                  { TRY specification.set_heap_size_function(*$3); delete $3; CATCH }
+                | Root OPT_LAYOUT                                               { TRY specification.set_optimize_layout(); CATCH }
+                | Root COMPACT_LOC                                              { TRY specification.set_compact_location(); CATCH }
                 | Root INCLUDE                                                  { TRY specification.add_include(std::string($2)); std::free($2); CATCH }
                 | Root SRC_INCLUDE                                              { TRY specification.add_src_include(std::string($2 + 4)); std::free($2); CATCH }
                 | Root PY_INCLUDE                                               { TRY specification.add_python_include(std::string($2)); std::free($2); CATCH }
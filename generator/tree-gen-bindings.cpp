@@ -0,0 +1,1706 @@
+/** \file
+ * Python binding generation source file for \ref tree-gen.
+ */
+
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <unordered_set>
+#include <stdexcept>
+#include "tree-gen-bindings.hpp"
+#include "tree-gen-cpp.hpp"
+
+namespace tree_gen {
+namespace bindings {
+
+/**
+ * Returns the given filename without its path.
+ */
+std::string get_basename(const std::string &filename) {
+    auto sep_pos = filename.rfind('/');
+    auto backslash_pos = filename.rfind('\\');
+    if (backslash_pos != std::string::npos && (sep_pos == std::string::npos || backslash_pos > sep_pos)) {
+        sep_pos = backslash_pos;
+    }
+    if (sep_pos == std::string::npos) {
+        return filename;
+    }
+    return filename.substr(sep_pos + 1);
+}
+
+/**
+ * Returns the name of the Python module corresponding to the given filename,
+ * being its basename without extension, with characters that can't appear in
+ * an identifier replaced by underscores.
+ */
+std::string get_module_name(const std::string &filename) {
+    auto name = get_basename(filename);
+    auto dot_pos = name.find('.');
+    if (dot_pos != std::string::npos) {
+        name = name.substr(0, dot_pos);
+    }
+    std::transform(
+        name.begin(), name.end(), name.begin(),
+        [](unsigned char c) {
+            return std::isalnum(c) ? static_cast<char>(c) : '_';
+        }
+    );
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        name = "_" + name;
+    }
+    return name;
+}
+
+/**
+ * Returns the given string as a C string literal.
+ */
+std::string c_string(const std::string &value) {
+    std::ostringstream ss;
+    ss << "\"";
+    for (char c : value) {
+        switch (c) {
+            case '\\': ss << "\\\\"; break;
+            case '"':  ss << "\\\""; break;
+            case '\n': ss << "\\n"; break;
+            case '\t': ss << "\\t"; break;
+            default:   ss << c; break;
+        }
+    }
+    ss << "\"";
+    return ss.str();
+}
+
+/**
+ * Returns the name of the TypeIndex enumerator for the given node type.
+ */
+std::string get_index_name(const Node &node) {
+    auto name = node.snake_case_name;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    return name + "_INDEX";
+}
+
+/**
+ * Returns whether the given field is a primitive, as opposed to a node or an
+ * edge to a node from another tree.
+ */
+bool is_primitive(const Field &field) {
+    return field.type == Prim && field.ext_type == Prim;
+}
+
+/**
+ * Generates the getter and (if applicable) the setter for the given field of
+ * the given node type. Edges to nodes from another tree are not exposed.
+ */
+void generate_field_accessors(
+    std::ostream &source,
+    const Node &node,
+    const Field &field,
+    const std::map<std::string, size_t> &primitives
+) {
+    auto prefix = node.snake_case_name + "_" + field.name;
+    auto cast = "static_cast<" + node.title_case_name + "&>(node_of(self))";
+    auto type = (field.type == Prim) ? field.ext_type : field.type;
+
+    // Any and Many fields are exposed through a list-like object that
+    // accesses the field through a function pointer.
+    if (type == Any || type == Many) {
+        auto element = field.node_type->title_case_name;
+        source << "/**" << std::endl;
+        source << " * Returns the " << field.name << " field of the given ";
+        source << node.title_case_name << " node." << std::endl;
+        source << " */" << std::endl;
+        source << "static Any<" << element << "> &access_" << prefix << "(Node &node) {" << std::endl;
+        source << "    return static_cast<" << node.title_case_name << "&>(node)." << field.name << ";" << std::endl;
+        source << "}" << std::endl << std::endl;
+        source << "/**" << std::endl;
+        source << " * List accessor for the " << field.name << " field of ";
+        source << node.title_case_name << " nodes." << std::endl;
+        source << " */" << std::endl;
+        source << "static const ListFieldImpl<" << element << "> list_" << prefix;
+        source << "{&access_" << prefix << ", " << get_index_name(*field.node_type);
+        source << ", \"" << field.name << "\"};" << std::endl << std::endl;
+    }
+
+    // Generate the getter.
+    source << "/**" << std::endl;
+    source << " * Getter for the " << field.name << " field of ";
+    source << node.title_case_name << " nodes." << std::endl;
+    source << " */" << std::endl;
+    source << "static PyObject *get_" << prefix << "(PyObject *self, void*) {" << std::endl;
+    source << "    try {" << std::endl;
+    switch (type) {
+        case Prim:
+            source << "        auto &node = " << cast << ";" << std::endl;
+            source << "        return primitive_to_python<" << field.prim_type << ">(node.";
+            source << field.name << (field.cold ? ".get()" : "") << ", ";
+            source << primitives.at(field.py_prim_type) << ");" << std::endl;
+            break;
+        case Maybe:
+        case One:
+            source << "        auto &node = " << cast << ";" << std::endl;
+            if (field.is_inline) {
+                source << "        return wrap(std::shared_ptr<Node>(proxy_of(self), &*node.";
+                source << field.name << "));" << std::endl;
+            } else {
+                source << "        return wrap(node." << field.name << ".get_ptr());" << std::endl;
+            }
+            break;
+        case Any:
+        case Many:
+            source << "        return wrap_list(proxy_of(self), &list_" << prefix << ");" << std::endl;
+            break;
+        case OptLink:
+        case Link:
+            source << "        auto &node = " << cast << ";" << std::endl;
+            source << "        return wrap(node." << field.name << ".get_ptr());" << std::endl;
+            break;
+    }
+    source << "    } catch (...) {" << std::endl;
+    source << "        return translate_exception();" << std::endl;
+    source << "    }" << std::endl;
+    source << "}" << std::endl << std::endl;
+
+    // Inline nodes are stored by value, so they can't be replaced by another
+    // node object; only their fields can be modified.
+    if (field.is_inline) {
+        return;
+    }
+
+    // Generate the setter. Deleting the attribute behaves like assigning None,
+    // which resets the field to its default value.
+    source << "/**" << std::endl;
+    source << " * Setter for the " << field.name << " field of ";
+    source << node.title_case_name << " nodes." << std::endl;
+    source << " */" << std::endl;
+    source << "static int set_" << prefix << "(PyObject *self, PyObject *value, void*) {" << std::endl;
+    source << "    try {" << std::endl;
+    source << "        auto &node = " << cast << ";" << std::endl;
+    switch (type) {
+        case Prim:
+            source << "        node." << field.name << " = primitive_from_python<";
+            source << field.prim_type << ">(value, ";
+            source << primitives.at(field.py_prim_type) << ");" << std::endl;
+            break;
+        case Maybe:
+        case One:
+            source << "        node." << field.name << ".set(std::static_pointer_cast<";
+            source << field.node_type->title_case_name << ">(unwrap(value, ";
+            source << get_index_name(*field.node_type) << ", \"" << field.name;
+            source << "\", true)));" << std::endl;
+            break;
+        case Any:
+        case Many:
+            source << "        list_" << prefix << ".assign(node, value);" << std::endl;
+            break;
+        case OptLink:
+        case Link:
+            source << "        node." << field.name << ".set(Maybe<";
+            source << field.node_type->title_case_name << ">(unwrap(value, ";
+            source << get_index_name(*field.node_type) << ", \"" << field.name;
+            source << "\", true)));" << std::endl;
+            break;
+    }
+    source << "        return 0;" << std::endl;
+    source << "    } catch (...) {" << std::endl;
+    source << "        translate_exception();" << std::endl;
+    source << "        return -1;" << std::endl;
+    source << "    }" << std::endl;
+    source << "}" << std::endl << std::endl;
+}
+
+/**
+ * Generates the field accessors, constructor, and type specification for the
+ * proxy type of the given node type.
+ */
+void generate_type(
+    std::ostream &source,
+    const std::string &module_name,
+    const Node &node,
+    const std::map<std::string, size_t> &primitives
+) {
+    bool is_leaf = node.derived.empty();
+
+    // Generate the field accessors. Fields of parent types are inherited
+    // through the Python type hierarchy.
+    std::vector<Field> fields;
+    for (const auto &field : node.fields) {
+        if (field.type == Prim && field.ext_type != Prim) {
+            continue;
+        }
+        fields.push_back(field);
+        generate_field_accessors(source, node, field, primitives);
+    }
+    source << "/**" << std::endl;
+    source << " * Attributes of " << node.title_case_name << " proxies." << std::endl;
+    source << " */" << std::endl;
+    source << "static PyGetSetDef " << node.snake_case_name << "_getset[] = {" << std::endl;
+    for (const auto &field : fields) {
+        auto prefix = node.snake_case_name + "_" + field.name;
+        source << "    {\"" << field.name << "\", get_" << prefix << ", ";
+        source << (field.is_inline ? "nullptr" : ("set_" + prefix)) << ", ";
+        source << c_string(field.doc) << ", nullptr}," << std::endl;
+    }
+    source << "    {nullptr, nullptr, nullptr, nullptr, nullptr}" << std::endl;
+    source << "};" << std::endl << std::endl;
+
+    // Generate the constructor for leaf types, which takes the same arguments
+    // as the one of the pure-Python class.
+    if (is_leaf) {
+        source << "/**" << std::endl;
+        source << " * Constructs a new " << node.title_case_name << " node." << std::endl;
+        source << " */" << std::endl;
+        source << "static PyObject *new_" << node.snake_case_name << "(PyTypeObject*, PyObject *args, PyObject *kwargs) {" << std::endl;
+        source << "    static const char *const FIELDS[] = {";
+        for (const auto &field : node.all_fields()) {
+            source << "\"" << field.name << "\", ";
+        }
+        source << "nullptr};" << std::endl;
+        source << "    try {" << std::endl;
+        source << "        return construct(std::make_shared<" << node.title_case_name;
+        source << ">(), FIELDS, args, kwargs);" << std::endl;
+        source << "    } catch (...) {" << std::endl;
+        source << "        return translate_exception();" << std::endl;
+        source << "    }" << std::endl;
+        source << "}" << std::endl << std::endl;
+    }
+
+    // Generate the type specification.
+    source << "/**" << std::endl;
+    source << " * Slots of the " << node.title_case_name << " proxy type." << std::endl;
+    source << " */" << std::endl;
+    source << "static PyType_Slot " << node.snake_case_name << "_slots[] = {" << std::endl;
+    source << "    {Py_tp_doc, (void*)" << c_string(node.doc) << "}," << std::endl;
+    source << "    {Py_tp_getset, " << node.snake_case_name << "_getset}," << std::endl;
+    if (is_leaf) {
+        source << "    {Py_tp_new, (void*)new_" << node.snake_case_name << "}," << std::endl;
+    }
+    source << "    {0, nullptr}" << std::endl;
+    source << "};" << std::endl << std::endl;
+    source << "/**" << std::endl;
+    source << " * Specification of the " << node.title_case_name << " proxy type." << std::endl;
+    source << " */" << std::endl;
+    source << "static PyType_Spec " << node.snake_case_name << "_spec = {" << std::endl;
+    source << "    \"" << module_name << "." << node.title_case_name << "\"," << std::endl;
+    source << "    sizeof(Proxy)," << std::endl;
+    source << "    0," << std::endl;
+    source << "    Py_TPFLAGS_DEFAULT" << (is_leaf ? "" : " | Py_TPFLAGS_BASETYPE") << "," << std::endl;
+    source << "    " << node.snake_case_name << "_slots" << std::endl;
+    source << "};" << std::endl << std::endl;
+}
+
+/**
+ * Generates the header and source file of a CPython extension module that
+ * exposes the C++ node classes generated into the given header file to
+ * Python. The module is named after the source file, without its extension.
+ * python_filename must be the Python file generated for the same
+ * specification; the module generated into it is used to convert primitives.
+ */
+void generate(
+    const std::string &header_filename,
+    const std::string &source_filename,
+    const std::string &tree_header_filename,
+    const std::string &python_filename,
+    Specification &specification
+) {
+    if (specification.serialize_fn.empty() || specification.deserialize_fn.empty()) {
+        throw std::runtime_error(
+            "Python bindings require serialize/deserialize functions for the "
+            "primitives; see the serdes_functions directive");
+    }
+
+    // Order the node types such that parents come before their children, as
+    // the proxy types must be created in that order.
+    Nodes nodes;
+    std::unordered_set<std::string> ordered;
+    for (auto node : specification.nodes) {
+        auto ancestors = Nodes();
+        while (node) {
+            ancestors.push_back(node);
+            node = node->parent;
+        }
+        for (auto node_it = ancestors.rbegin(); node_it != ancestors.rend(); node_it++) {
+            if (ordered.insert((*node_it)->snake_case_name).second) {
+                nodes.push_back(*node_it);
+            }
+        }
+    }
+
+    // Number the distinct primitive types in order of first use.
+    std::map<std::string, size_t> primitives;
+    std::vector<std::string> primitive_names;
+    for (const auto &node : nodes) {
+        for (const auto &field : node->fields) {
+            if (is_primitive(field) && !primitives.count(field.py_prim_type)) {
+                primitives[field.py_prim_type] = primitive_names.size();
+                primitive_names.push_back(field.py_prim_type);
+            }
+        }
+    }
+
+    auto module_name = get_module_name(source_filename);
+    auto python_module_name = get_module_name(python_filename);
+    auto tree_header = specification.header_fname.empty()
+        ? get_basename(tree_header_filename) : specification.header_fname;
+
+    // Generate into memory first, such that files that didn't change don't
+    // have to be touched.
+    std::ostringstream header;
+    std::ostringstream source;
+
+    // Generate the header file.
+    cpp::format_doc(
+        header,
+        "Python bindings for the tree defined in " + tree_header + ", "
+        "exposing its node objects to Python as the " + module_name +
+        " extension module.", "", "\\file");
+    header << std::endl;
+    header << "#pragma once" << std::endl;
+    header << std::endl;
+    header << "#include <Python.h>" << std::endl;
+    header << "#include \"" << tree_header << "\"" << std::endl;
+    header << std::endl;
+    for (auto &name : specification.namespaces) {
+        header << "namespace " << name << " {" << std::endl;
+    }
+    header << std::endl;
+    cpp::format_doc(header, "Python bindings for the tree.");
+    header << "namespace python {" << std::endl << std::endl;
+    cpp::format_doc(
+        header,
+        "Returns a new reference to a Python proxy object for the given node, "
+        "or to None if it is empty. The proxy shares the node with the C++ "
+        "tree, so modifications made through it are visible on both sides. "
+        "Imports the " + module_name + " module if this hasn't been done yet. "
+        "Returns nullptr with a Python exception set on failure. The GIL must "
+        "be held.");
+    header << "PyObject *to_proxy(const Maybe<Node> &node);" << std::endl << std::endl;
+    cpp::format_doc(
+        header,
+        "Returns the node wrapped by the given Python proxy object, or an "
+        "empty Maybe if the object is None. Returns an empty Maybe with a "
+        "Python exception (TypeError) set if the object is not a proxy. The "
+        "GIL must be held.");
+    header << "Maybe<Node> from_proxy(PyObject *object);" << std::endl << std::endl;
+    header << "} // namespace python" << std::endl;
+    for (auto name_it = specification.namespaces.rbegin(); name_it != specification.namespaces.rend(); name_it++) {
+        header << "} // namespace " << *name_it << std::endl;
+    }
+    header << std::endl;
+    cpp::format_doc(
+        header,
+        "Entry point of the " + module_name + " extension module. When "
+        "embedding Python, register it using PyImport_AppendInittab() before "
+        "Py_Initialize().");
+    header << "PyMODINIT_FUNC PyInit_" << module_name << "(void);" << std::endl;
+
+    // Generate the source file header.
+    cpp::format_doc(
+        source,
+        "Python bindings for the tree defined in " + tree_header + ".",
+        "", "\\file");
+    source << std::endl;
+    source << "#define PY_SSIZE_T_CLEAN" << std::endl;
+    source << "#include <Python.h>" << std::endl;
+    source << "#include <new>" << std::endl;
+    source << "#include <sstream>" << std::endl;
+    source << "#include \"" << get_basename(header_filename) << "\"" << std::endl;
+    source << std::endl;
+    for (auto &name : specification.namespaces) {
+        source << "namespace " << name << " {" << std::endl;
+    }
+    source << "namespace python {" << std::endl << std::endl;
+    source << "namespace support = " << specification.support_namespace << ";" << std::endl << std::endl;
+
+    // Generate the constants that the runtime code below depends on.
+    cpp::format_doc(source, "Name of this extension module.");
+    source << "static const char *const MODULE_NAME = \"" << module_name << "\";" << std::endl << std::endl;
+    cpp::format_doc(source, "Name of the pure-Python module generated for the same tree.");
+    source << "static const char *const PYTHON_MODULE_NAME = \"" << python_module_name << "\";" << std::endl << std::endl;
+    cpp::format_doc(source, "Indices of the proxy types, parents before children.");
+    source << "enum TypeIndex {" << std::endl;
+    source << "    NODE_INDEX," << std::endl;
+    for (const auto &node : nodes) {
+        source << "    " << get_index_name(*node) << "," << std::endl;
+    }
+    source << "    TYPE_COUNT" << std::endl;
+    source << "};" << std::endl << std::endl;
+    cpp::format_doc(source, "Returns the index of the proxy type for the given node type.");
+    source << "static TypeIndex leaf_index(NodeType type) {" << std::endl;
+    source << "    switch (type) {" << std::endl;
+    for (const auto &node : nodes) {
+        if (node->derived.empty()) {
+            source << "        case NodeType::" << node->title_case_name << ": ";
+            source << "return " << get_index_name(*node) << ";" << std::endl;
+        }
+    }
+    source << "    }" << std::endl;
+    source << "    return NODE_INDEX;" << std::endl;
+    source << "}" << std::endl << std::endl;
+    cpp::format_doc(
+        source,
+        "Python expressions for the primitive types, evaluated in the "
+        "namespace of the pure-Python module, and terminated by nullptr.");
+    source << "static const char *const PRIMITIVE_NAMES[] = {";
+    for (const auto &name : primitive_names) {
+        source << c_string(name) << ", ";
+    }
+    source << "nullptr};" << std::endl << std::endl;
+    cpp::format_doc(source, "Number of primitive types.");
+    source << "static const size_t PRIM_COUNT = " << primitive_names.size() << ";" << std::endl << std::endl;
+    cpp::format_doc(
+        source,
+        "Python expressions for the primitive serialization and "
+        "deserialization functions, if any.");
+    source << "static const char *const SERIALIZE_FN = ";
+    source << (specification.py_serialize_fn.empty() ? "nullptr" : c_string(specification.py_serialize_fn)) << ";" << std::endl;
+    source << "static const char *const DESERIALIZE_FN = ";
+    source << (specification.py_deserialize_fn.empty() ? "nullptr" : c_string(specification.py_deserialize_fn)) << ";" << std::endl;
+
+    // Write the runtime code that is always the same.
+    source << R"CPP(
+/**
+ * Exception used to unwind to the Python API boundary when a Python exception
+ * has been set.
+ */
+class PythonError : public std::exception {
+public:
+    const char *what() const noexcept override {
+        return "a Python exception has been set";
+    }
+};
+
+/**
+ * Owned reference to a Python object.
+ */
+class Ref {
+private:
+    PyObject *object;
+public:
+    explicit Ref(PyObject *object = nullptr) : object(object) {}
+    Ref(Ref &&src) noexcept : object(src.object) { src.object = nullptr; }
+    Ref &operator=(Ref &&src) noexcept { std::swap(object, src.object); return *this; }
+    Ref(const Ref&) = delete;
+    Ref &operator=(const Ref&) = delete;
+    ~Ref() { Py_XDECREF(object); }
+    PyObject *get() const { return object; }
+    PyObject *release() { auto result = object; object = nullptr; return result; }
+};
+
+/**
+ * Takes ownership of the given new reference. Throws PythonError if it is
+ * null, which means that the call that returned it raised an exception.
+ */
+static Ref check(PyObject *object) {
+    if (!object) {
+        throw PythonError();
+    }
+    return Ref(object);
+}
+
+/**
+ * Python object wrapping a node. The node is shared with the C++ tree; the
+ * pointer to an inline node shares ownership with the node containing it.
+ */
+struct Proxy {
+    PyObject_HEAD
+    std::shared_ptr<Node> node;
+};
+
+class ListField;
+
+/**
+ * Python object wrapping an Any or Many field of a node.
+ */
+struct EdgeList {
+    PyObject_HEAD
+    std::shared_ptr<Node> node;
+    const ListField *field;
+};
+
+/**
+ * Python objects used by the module, set up when it is first initialized.
+ */
+static struct {
+
+    /**
+     * The pure-Python module generated for the same tree.
+     */
+    PyObject *module;
+
+    /**
+     * The proxy types.
+     */
+    PyTypeObject *types[TYPE_COUNT];
+
+    /**
+     * The EdgeList type.
+     */
+    PyTypeObject *edge_list;
+
+    /**
+     * The Python types of the primitives.
+     */
+    PyObject *primitives[PRIM_COUNT + 1];
+
+    /**
+     * The Python primitive serialization and deserialization functions, if
+     * any.
+     */
+    PyObject *serialize_fn;
+    PyObject *deserialize_fn;
+
+    /**
+     * The CBOR conversion functions of the pure-Python module.
+     */
+    PyObject *cbor_to_py;
+    PyObject *py_to_cbor;
+
+    /**
+     * The NotWellFormed exception and Node class of the pure-Python module.
+     */
+    PyObject *not_well_formed;
+    PyObject *node_class;
+
+} state;
+
+/**
+ * Converts the exception currently being handled to a Python exception.
+ * Returns nullptr for convenience.
+ */
+static PyObject *translate_exception() {
+    try {
+        throw;
+    } catch (const PythonError&) {
+    } catch (const support::base::NotWellFormed &e) {
+        PyErr_SetString(state.not_well_formed ? state.not_well_formed : PyExc_ValueError, e.what());
+    } catch (const support::base::OutOfRange &e) {
+        PyErr_SetString(PyExc_IndexError, e.what());
+    } catch (const std::bad_alloc&) {
+        PyErr_NoMemory();
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+    return nullptr;
+}
+
+/**
+ * Returns the shared pointer to the node wrapped by the given proxy.
+ */
+static const std::shared_ptr<Node> &proxy_of(PyObject *self) {
+    return reinterpret_cast<Proxy*>(self)->node;
+}
+
+/**
+ * Returns the node wrapped by the given proxy.
+ */
+static Node &node_of(PyObject *self) {
+    return *proxy_of(self);
+}
+
+/**
+ * Returns a new proxy object for the given node, or None if it is null.
+ */
+static PyObject *wrap(const std::shared_ptr<Node> &node) {
+    if (!node) {
+        Py_RETURN_NONE;
+    }
+    auto type = state.types[leaf_index(node->type())];
+    auto object = type->tp_alloc(type, 0);
+    if (!object) {
+        throw PythonError();
+    }
+    new (&reinterpret_cast<Proxy*>(object)->node) std::shared_ptr<Node>(node);
+    return object;
+}
+
+/**
+ * Returns the node wrapped by the given proxy object, which must have the
+ * proxy type with the given index. None (or null, for deleted attributes)
+ * maps to null if allow_none is set. Raises TypeError otherwise, naming the
+ * given field.
+ */
+static std::shared_ptr<Node> unwrap(PyObject *object, TypeIndex type, const char *field, bool allow_none) {
+    if (!object || object == Py_None) {
+        if (allow_none) {
+            return nullptr;
+        }
+    } else if (PyObject_TypeCheck(object, state.types[type])) {
+        return proxy_of(object);
+    }
+    PyErr_Format(PyExc_TypeError, "%s must be of type %s", field, state.types[type]->tp_name);
+    throw PythonError();
+}
+
+/**
+ * Accessor for an Any or Many field of a node, used by EdgeList objects.
+ */
+class ListField {
+public:
+    virtual ~ListField() = default;
+
+    /**
+     * Returns the number of nodes in the field.
+     */
+    virtual size_t size(Node &node) const = 0;
+
+    /**
+     * Returns the node at the given index, which must be in range.
+     */
+    virtual std::shared_ptr<Node> get(Node &node, size_t index) const = 0;
+
+    /**
+     * Replaces the node at the given index, which must be in range, with the
+     * node wrapped by the given proxy.
+     */
+    virtual void set(Node &node, size_t index, PyObject *value) const = 0;
+
+    /**
+     * Inserts the node wrapped by the given proxy before the given index,
+     * which must be at most the size.
+     */
+    virtual void insert(Node &node, size_t index, PyObject *value) const = 0;
+
+    /**
+     * Removes the node at the given index, which must be in range.
+     */
+    virtual void remove(Node &node, size_t index) const = 0;
+
+    /**
+     * Replaces the contents of the field with the nodes wrapped by the
+     * proxies in the given iterable, or clears it if the iterable is None.
+     * The field is left unchanged if an element has the wrong type.
+     */
+    virtual void assign(Node &node, PyObject *values) const = 0;
+
+};
+
+/**
+ * Accessor for an Any or Many field with the given node type.
+ */
+template <class T>
+class ListFieldImpl : public ListField {
+private:
+
+    /**
+     * Function returning the field of the given node.
+     */
+    Any<T> &(*access)(Node&);
+
+    /**
+     * Index of the proxy type for T.
+     */
+    TypeIndex type;
+
+    /**
+     * Name of the field, for error messages.
+     */
+    const char *name;
+
+    /**
+     * Returns the node wrapped by the given proxy as an edge.
+     */
+    One<T> unwrap_element(PyObject *value) const {
+        return One<T>(std::static_pointer_cast<T>(unwrap(value, type, name, false)));
+    }
+
+public:
+
+    ListFieldImpl(Any<T> &(*access)(Node&), TypeIndex type, const char *name)
+        : access(access), type(type), name(name) {}
+
+    size_t size(Node &node) const override {
+        return access(node).size();
+    }
+
+    std::shared_ptr<Node> get(Node &node, size_t index) const override {
+        return access(node).get_vec()[index].get_ptr();
+    }
+
+    void set(Node &node, size_t index, PyObject *value) const override {
+        access(node).get_vec()[index] = unwrap_element(value);
+    }
+
+    void insert(Node &node, size_t index, PyObject *value) const override {
+        auto element = unwrap_element(value);
+        auto &vec = access(node).get_vec();
+        vec.insert(vec.begin() + index, std::move(element));
+    }
+
+    void remove(Node &node, size_t index) const override {
+        auto &vec = access(node).get_vec();
+        vec.erase(vec.begin() + index);
+    }
+
+    void assign(Node &node, PyObject *values) const override {
+        std::vector<One<T>> elements;
+        if (values && values != Py_None) {
+            auto iterator = check(PyObject_GetIter(values));
+            while (true) {
+                Ref item{PyIter_Next(iterator.get())};
+                if (!item.get()) {
+                    break;
+                }
+                elements.push_back(unwrap_element(item.get()));
+            }
+            if (PyErr_Occurred()) {
+                throw PythonError();
+            }
+        }
+        auto &vec = access(node).get_vec();
+        vec.clear();
+        for (auto &element : elements) {
+            vec.push_back(std::move(element));
+        }
+    }
+
+};
+
+/**
+ * Returns a new EdgeList object for the given field of the given node.
+ */
+static PyObject *wrap_list(const std::shared_ptr<Node> &node, const ListField *field) {
+    auto object = state.edge_list->tp_alloc(state.edge_list, 0);
+    if (!object) {
+        throw PythonError();
+    }
+    auto list = reinterpret_cast<EdgeList*>(object);
+    new (&list->node) std::shared_ptr<Node>(node);
+    list->field = field;
+    return object;
+}
+
+/**
+ * Converts the given index of an EdgeList to an unsigned index, handling
+ * negative indices like Python lists do. Raises IndexError if the result is
+ * out of range, taking the given size as the upper bound.
+ */
+static size_t list_index(Py_ssize_t index, size_t size) {
+    if (index < 0) {
+        index += (Py_ssize_t)size;
+    }
+    if (index < 0 || (size_t)index >= size) {
+        PyErr_SetString(PyExc_IndexError, "edge list index out of range");
+        throw PythonError();
+    }
+    return (size_t)index;
+}
+
+/**
+ * Deallocates an EdgeList object.
+ */
+static void edge_list_dealloc(PyObject *self) {
+    auto type = Py_TYPE(self);
+    reinterpret_cast<EdgeList*>(self)->node.~shared_ptr();
+    type->tp_free(self);
+    Py_DECREF(type);
+}
+
+/**
+ * Implements len() for EdgeList objects.
+ */
+static Py_ssize_t edge_list_length(PyObject *self) {
+    auto list = reinterpret_cast<EdgeList*>(self);
+    return (Py_ssize_t)list->field->size(*list->node);
+}
+
+/**
+ * Implements indexing for EdgeList objects.
+ */
+static PyObject *edge_list_item(PyObject *self, Py_ssize_t index) {
+    try {
+        auto list = reinterpret_cast<EdgeList*>(self);
+        auto &node = *list->node;
+        return wrap(list->field->get(node, list_index(index, list->field->size(node))));
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements item assignment and deletion for EdgeList objects.
+ */
+static int edge_list_ass_item(PyObject *self, Py_ssize_t index, PyObject *value) {
+    try {
+        auto list = reinterpret_cast<EdgeList*>(self);
+        auto &node = *list->node;
+        auto position = list_index(index, list->field->size(node));
+        if (value) {
+            list->field->set(node, position, value);
+        } else {
+            list->field->remove(node, position);
+        }
+        return 0;
+    } catch (...) {
+        translate_exception();
+        return -1;
+    }
+}
+
+/**
+ * Implements EdgeList.append(node).
+ */
+static PyObject *edge_list_append(PyObject *self, PyObject *value) {
+    try {
+        auto list = reinterpret_cast<EdgeList*>(self);
+        auto &node = *list->node;
+        list->field->insert(node, list->field->size(node), value);
+        Py_RETURN_NONE;
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements EdgeList.extend(iterable).
+ */
+static PyObject *edge_list_extend(PyObject *self, PyObject *values) {
+    try {
+        auto list = reinterpret_cast<EdgeList*>(self);
+        auto &node = *list->node;
+        auto iterator = check(PyObject_GetIter(values));
+        while (true) {
+            Ref item{PyIter_Next(iterator.get())};
+            if (!item.get()) {
+                break;
+            }
+            list->field->insert(node, list->field->size(node), item.get());
+        }
+        if (PyErr_Occurred()) {
+            throw PythonError();
+        }
+        Py_RETURN_NONE;
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements EdgeList.insert(index, node), clamping the index like
+ * list.insert() does.
+ */
+static PyObject *edge_list_insert(PyObject *self, PyObject *args) {
+    try {
+        Py_ssize_t index;
+        PyObject *value;
+        if (!PyArg_ParseTuple(args, "nO:insert", &index, &value)) {
+            throw PythonError();
+        }
+        auto list = reinterpret_cast<EdgeList*>(self);
+        auto &node = *list->node;
+        auto size = (Py_ssize_t)list->field->size(node);
+        if (index < 0) {
+            index = std::max<Py_ssize_t>(index + size, 0);
+        }
+        list->field->insert(node, (size_t)std::min(index, size), value);
+        Py_RETURN_NONE;
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements EdgeList.pop(index=-1).
+ */
+static PyObject *edge_list_pop(PyObject *self, PyObject *args) {
+    try {
+        Py_ssize_t index = -1;
+        if (!PyArg_ParseTuple(args, "|n:pop", &index)) {
+            throw PythonError();
+        }
+        auto list = reinterpret_cast<EdgeList*>(self);
+        auto &node = *list->node;
+        auto position = list_index(index, list->field->size(node));
+        auto result = check(wrap(list->field->get(node, position)));
+        list->field->remove(node, position);
+        return result.release();
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements EdgeList.clear().
+ */
+static PyObject *edge_list_clear(PyObject *self, PyObject*) {
+    try {
+        auto list = reinterpret_cast<EdgeList*>(self);
+        list->field->assign(*list->node, Py_None);
+        Py_RETURN_NONE;
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Methods of EdgeList objects.
+ */
+static PyMethodDef edge_list_methods[] = {
+    {"append", (PyCFunction)edge_list_append, METH_O, "Appends the given node."},
+    {"extend", (PyCFunction)edge_list_extend, METH_O, "Appends the nodes in the given iterable."},
+    {"insert", (PyCFunction)edge_list_insert, METH_VARARGS, "Inserts the given node before the given index."},
+    {"pop", (PyCFunction)edge_list_pop, METH_VARARGS, "Removes and returns the node at the given index, by default the last."},
+    {"clear", (PyCFunction)edge_list_clear, METH_NOARGS, "Removes all nodes."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+/**
+ * Slots of the EdgeList type.
+ */
+static PyType_Slot edge_list_slots[] = {
+    {Py_tp_doc, (void*)"List-like view of an Any or Many field of a node."},
+    {Py_tp_dealloc, (void*)edge_list_dealloc},
+    {Py_tp_methods, edge_list_methods},
+    {Py_sq_length, (void*)edge_list_length},
+    {Py_sq_item, (void*)edge_list_item},
+    {Py_sq_ass_item, (void*)edge_list_ass_item},
+    {0, nullptr}
+};
+
+/**
+ * Converts the CBOR serialization of a primitive to an instance of the
+ * primitive type with the given index, the same way the pure-Python module
+ * deserializes it.
+ */
+static PyObject *load_primitive(const std::string &data, size_t prim) {
+    auto bytes = check(PyBytes_FromStringAndSize(data.data(), (Py_ssize_t)data.size()));
+    auto value = check(PyObject_CallFunctionObjArgs(state.cbor_to_py, bytes.get(), nullptr));
+    auto type = state.primitives[prim];
+    if (PyObject_HasAttrString(type, "deserialize_cbor")) {
+        return check(PyObject_CallMethod(type, "deserialize_cbor", "O", value.get())).release();
+    }
+    if (!state.deserialize_fn) {
+        PyErr_Format(PyExc_ValueError, "no deserialization function seems to exist for field type %R", type);
+        throw PythonError();
+    }
+    return check(PyObject_CallFunctionObjArgs(state.deserialize_fn, type, value.get(), nullptr)).release();
+}
+
+/**
+ * Converts the given Python object to the CBOR serialization of a primitive
+ * of the type with the given index, the same way the pure-Python module
+ * typecasts and serializes it.
+ */
+static std::string dump_primitive(PyObject *value, size_t prim) {
+    auto type = state.primitives[prim];
+    Ref cast;
+    auto is_instance = PyObject_IsInstance(value, type);
+    if (is_instance < 0) {
+        throw PythonError();
+    }
+    if (!is_instance) {
+        if (PyObject_TypeCheck(value, state.types[NODE_INDEX]) || PyObject_IsInstance(value, state.node_class) > 0) {
+            PyErr_Format(PyExc_TypeError, "expected an instance of %R, got a node", type);
+            throw PythonError();
+        }
+        cast = check(PyObject_CallFunctionObjArgs(type, value, nullptr));
+        value = cast.get();
+    }
+    Ref cbor;
+    if (PyObject_HasAttrString(value, "serialize_cbor")) {
+        cbor = check(PyObject_CallMethod(value, "serialize_cbor", nullptr));
+    } else if (state.serialize_fn) {
+        cbor = check(PyObject_CallFunctionObjArgs(state.serialize_fn, type, value, nullptr));
+    } else {
+        PyErr_Format(PyExc_ValueError, "no serialization function seems to exist for field type %R", type);
+        throw PythonError();
+    }
+    auto data = check(PyObject_CallFunctionObjArgs(state.py_to_cbor, cbor.get(), nullptr));
+    char *buffer;
+    Py_ssize_t size;
+    if (PyBytes_AsStringAndSize(data.get(), &buffer, &size) < 0) {
+        throw PythonError();
+    }
+    return std::string(buffer, (size_t)size);
+}
+
+/**
+ * C++ annotation holding the Python annotations of a node, being a dict
+ * mapping key strings to arbitrary Python objects.
+ */
+class PythonAnnotations {
+private:
+    PyObject *dict;
+public:
+    PythonAnnotations() : dict(PyDict_New()) {
+        if (!dict) {
+            throw PythonError();
+        }
+    }
+
+    // Nodes may be copied or destroyed from C++ code that doesn't hold the
+    // GIL, so acquire it here.
+    PythonAnnotations(const PythonAnnotations &src) {
+        auto gil = PyGILState_Ensure();
+        dict = PyDict_Copy(src.dict);
+        if (!dict) {
+            PyErr_Clear();
+        }
+        PyGILState_Release(gil);
+        if (!dict) {
+            throw std::bad_alloc();
+        }
+    }
+
+    PythonAnnotations(PythonAnnotations &&src) noexcept : dict(src.dict) {
+        src.dict = nullptr;
+    }
+
+    PythonAnnotations &operator=(const PythonAnnotations&) = delete;
+    PythonAnnotations &operator=(PythonAnnotations&&) = delete;
+
+    ~PythonAnnotations() {
+        if (dict && Py_IsInitialized()) {
+            auto gil = PyGILState_Ensure();
+            Py_DECREF(dict);
+            PyGILState_Release(gil);
+        }
+    }
+
+    PyObject *get() const {
+        return dict;
+    }
+};
+
+/**
+ * Raises TypeError if the given object is not a valid annotation key.
+ */
+static void check_annotation_key(PyObject *key) {
+    if (!PyUnicode_Check(key)) {
+        PyErr_SetString(PyExc_TypeError, "indexing a node with something other than an annotation key string");
+        throw PythonError();
+    }
+}
+
+/**
+ * Returns the annotation with the given key, or raises KeyError.
+ */
+static PyObject *node_get_annotation(PyObject *self, PyObject *key) {
+    try {
+        check_annotation_key(key);
+        auto annotations = node_of(self).get_annotation_ptr<PythonAnnotations>();
+        auto value = annotations ? PyDict_GetItemWithError(annotations->get(), key) : nullptr;
+        if (!value) {
+            if (!PyErr_Occurred()) {
+                PyErr_SetObject(PyExc_KeyError, key);
+            }
+            return nullptr;
+        }
+        Py_INCREF(value);
+        return value;
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Assigns or deletes the annotation with the given key.
+ */
+static int node_set_annotation(PyObject *self, PyObject *key, PyObject *value) {
+    try {
+        check_annotation_key(key);
+        auto &node = node_of(self);
+        if (node.is_shared()) {
+            PyErr_SetString(PyExc_TypeError, "shared nodes can't be annotated");
+            throw PythonError();
+        }
+        auto annotations = node.get_annotation_ptr<PythonAnnotations>();
+        if (!value) {
+            if (!annotations || PyDict_DelItem(annotations->get(), key) < 0) {
+                if (!PyErr_Occurred()) {
+                    PyErr_SetObject(PyExc_KeyError, key);
+                }
+                throw PythonError();
+            }
+            return 0;
+        }
+        if (!annotations) {
+            node.set_annotation(PythonAnnotations());
+            annotations = node.get_annotation_ptr<PythonAnnotations>();
+        }
+        if (PyDict_SetItem(annotations->get(), key, value) < 0) {
+            throw PythonError();
+        }
+        return 0;
+    } catch (...) {
+        translate_exception();
+        return -1;
+    }
+}
+
+/**
+ * Returns whether an annotation exists for the given key.
+ */
+static int node_has_annotation(PyObject *self, PyObject *key) {
+    try {
+        auto annotations = node_of(self).get_annotation_ptr<PythonAnnotations>();
+        return annotations ? PyDict_Contains(annotations->get(), key) : 0;
+    } catch (...) {
+        translate_exception();
+        return -1;
+    }
+}
+
+/**
+ * Deallocates a proxy object.
+ */
+static void node_dealloc(PyObject *self) {
+    auto type = Py_TYPE(self);
+    reinterpret_cast<Proxy*>(self)->node.~shared_ptr();
+    type->tp_free(self);
+    Py_DECREF(type);
+}
+
+/**
+ * Constructor for node types that can't be instantiated.
+ */
+static PyObject *node_new(PyTypeObject *type, PyObject*, PyObject*) {
+    PyErr_Format(PyExc_TypeError, "can't instantiate abstract node type %s", type->tp_name);
+    return nullptr;
+}
+
+/**
+ * Finishes construction of a node by assigning its fields from the given
+ * positional arguments, in the order of the given null-terminated field name
+ * list, and keyword arguments, like the constructors of the pure-Python node
+ * classes do. None arguments leave the default value in place. Returns the
+ * proxy object for the node.
+ */
+static PyObject *construct(
+    const std::shared_ptr<Node> &node,
+    const char *const *fields,
+    PyObject *args,
+    PyObject *kwargs
+) {
+    auto proxy = check(wrap(node));
+    Py_ssize_t field_count = 0;
+    while (fields[field_count]) {
+        field_count++;
+    }
+    auto arg_count = PyTuple_GET_SIZE(args);
+    if (arg_count > field_count) {
+        PyErr_Format(
+            PyExc_TypeError, "%s() takes at most %zd positional arguments (%zd given)",
+            Py_TYPE(proxy.get())->tp_name, field_count, arg_count);
+        throw PythonError();
+    }
+    for (Py_ssize_t i = 0; i < arg_count; i++) {
+        auto value = PyTuple_GET_ITEM(args, i);
+        if (value != Py_None && PyObject_SetAttrString(proxy.get(), fields[i], value) < 0) {
+            throw PythonError();
+        }
+    }
+    if (kwargs) {
+        PyObject *key;
+        PyObject *value;
+        Py_ssize_t position = 0;
+        while (PyDict_Next(kwargs, &position, &key, &value)) {
+            Py_ssize_t index = 0;
+            while (index < field_count && PyUnicode_CompareWithASCIIString(key, fields[index]) != 0) {
+                index++;
+            }
+            if (index == field_count) {
+                PyErr_Format(
+                    PyExc_TypeError, "%s() got an unexpected keyword argument %R",
+                    Py_TYPE(proxy.get())->tp_name, key);
+                throw PythonError();
+            }
+            if (index < arg_count) {
+                PyErr_Format(
+                    PyExc_TypeError, "%s() got multiple values for argument %R",
+                    Py_TYPE(proxy.get())->tp_name, key);
+                throw PythonError();
+            }
+            if (value != Py_None && PyObject_SetAttr(proxy.get(), key, value) < 0) {
+                throw PythonError();
+            }
+        }
+    }
+    return proxy.release();
+}
+
+/**
+ * Implements Node.serialize(), returning the CBOR serialization of the tree
+ * rooted at this node as bytes.
+ */
+static PyObject *node_serialize(PyObject *self, PyObject*) {
+    try {
+        auto data = support::base::serialize(Maybe<Node>(proxy_of(self)));
+        return PyBytes_FromStringAndSize(data.data(), (Py_ssize_t)data.size());
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements Node.copy(), returning a shallow copy of this node.
+ */
+static PyObject *node_copy(PyObject *self, PyObject*) {
+    try {
+        return wrap(node_of(self).copy().get_ptr());
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements Node.clone(), returning a deep copy of this node.
+ */
+static PyObject *node_clone(PyObject *self, PyObject*) {
+    try {
+        return wrap(node_of(self).clone().get_ptr());
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements Node.dump(), returning the debug dump of the C++ tree rooted at
+ * this node.
+ */
+static PyObject *node_dump(PyObject *self, PyObject*) {
+    try {
+        std::ostringstream ss;
+        node_of(self).dump(ss);
+        auto dump = ss.str();
+        while (!dump.empty() && dump.back() == '\n') {
+            dump.pop_back();
+        }
+        return PyUnicode_FromStringAndSize(dump.data(), (Py_ssize_t)dump.size());
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements repr() and str() for proxies, returning the debug dump.
+ */
+static PyObject *node_repr(PyObject *self) {
+    return node_dump(self, nullptr);
+}
+
+/**
+ * Implements Node.is_well_formed().
+ */
+static PyObject *node_is_well_formed(PyObject *self, PyObject*) {
+    try {
+        return PyBool_FromLong(Maybe<Node>(proxy_of(self)).is_well_formed());
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements Node.check_well_formed(), raising NotWellFormed if the tree
+ * rooted at this node is not well-formed.
+ */
+static PyObject *node_check_well_formed(PyObject *self, PyObject*) {
+    try {
+        Maybe<Node>(proxy_of(self)).check_well_formed();
+        Py_RETURN_NONE;
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Pushes the nodes owned by a field onto the stack used by node_visit(),
+ * sharing the ownership of inline nodes with the node that contains them.
+ */
+struct ChildPusher {
+    const std::shared_ptr<Node> &owner;
+    std::vector<std::shared_ptr<Node>> &stack;
+
+    template <class T>
+    typename std::enable_if<std::is_base_of<Node, T>::value>::type operator()(const char*, Maybe<T> &field) {
+        if (!field.empty()) {
+            stack.push_back(field.get_ptr());
+        }
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_base_of<Node, T>::value>::type operator()(const char*, One<T> &field) {
+        if (!field.empty()) {
+            stack.push_back(field.get_ptr());
+        }
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_base_of<Node, T>::value>::type operator()(const char*, support::base::Inline<T> &field) {
+        stack.push_back(std::shared_ptr<Node>(owner, &*field));
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_base_of<Node, T>::value>::type operator()(const char*, Any<T> &field) {
+        for (auto &child : field.get_vec()) {
+            if (!child.empty()) {
+                stack.push_back(child.get_ptr());
+            }
+        }
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_base_of<Node, T>::value>::type operator()(const char *name, Many<T> &field) {
+        (*this)(name, static_cast<Any<T>&>(field));
+    }
+
+    template <class T>
+    void operator()(const char*, T&) {
+    }
+
+    template <class T>
+    void operator()(T &node) {
+        // Fields are pushed in reverse order, such that they are popped in
+        // order.
+        std::vector<std::shared_ptr<Node>> children;
+        NodeTraits<T>::for_each_field(node, ChildPusher{owner, children});
+        stack.insert(stack.end(), children.rbegin(), children.rend());
+    }
+};
+
+/**
+ * Implements Node.visit(fn), calling fn for the proxy of each node in the
+ * tree rooted at this node, in pre-order. Children are skipped if fn returns
+ * False. Links are not followed.
+ */
+static PyObject *node_visit(PyObject *self, PyObject *fn) {
+    try {
+        std::vector<std::shared_ptr<Node>> stack{proxy_of(self)};
+        while (!stack.empty()) {
+            auto node = std::move(stack.back());
+            stack.pop_back();
+            auto proxy = check(wrap(node));
+            auto result = check(PyObject_CallFunctionObjArgs(fn, proxy.get(), nullptr));
+            if (result.get() == Py_False) {
+                continue;
+            }
+            dispatch(*node, ChildPusher{node, stack});
+        }
+        Py_RETURN_NONE;
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements Node.to_python(), returning a copy of the tree rooted at this
+ * node built from the classes of the pure-Python module.
+ */
+static PyObject *node_to_python(PyObject *self, PyObject*) {
+    try {
+        auto data = check(node_serialize(self, nullptr));
+        return check(PyObject_CallMethod(state.node_class, "deserialize", "O", data.get())).release();
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements == and != for proxies, comparing the trees rather than the
+ * proxy objects. Annotations are ignored.
+ */
+static PyObject *node_richcompare(PyObject *self, PyObject *other, int op) {
+    if ((op != Py_EQ && op != Py_NE) || !PyObject_TypeCheck(other, state.types[NODE_INDEX])) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    try {
+        auto equal = node_of(self).equals(node_of(other));
+        return PyBool_FromLong(equal == (op == Py_EQ));
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Methods of proxy objects.
+ */
+static PyMethodDef node_methods[] = {
+    {"serialize", (PyCFunction)node_serialize, METH_NOARGS, "Returns the CBOR serialization of the tree rooted at this node."},
+    {"copy", (PyCFunction)node_copy, METH_NOARGS, "Returns a shallow copy of this node."},
+    {"clone", (PyCFunction)node_clone, METH_NOARGS, "Returns a deep copy of this node."},
+    {"dump", (PyCFunction)node_dump, METH_NOARGS, "Returns a debug representation of the tree rooted at this node."},
+    {"is_well_formed", (PyCFunction)node_is_well_formed, METH_NOARGS, "Returns whether the tree rooted at this node is well-formed."},
+    {"check_well_formed", (PyCFunction)node_check_well_formed, METH_NOARGS, "Raises NotWellFormed if the tree rooted at this node is not well-formed."},
+    {"visit", (PyCFunction)node_visit, METH_O, "Calls the given function for each node in the tree rooted at this node, in pre-order, skipping the children of nodes for which it returns False."},
+    {"to_python", (PyCFunction)node_to_python, METH_NOARGS, "Returns a copy of the tree rooted at this node, built from the pure-Python node classes."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+/**
+ * Slots of the Node proxy type.
+ */
+static PyType_Slot node_slots[] = {
+    {Py_tp_doc, (void*)"Base class for node proxies."},
+    {Py_tp_dealloc, (void*)node_dealloc},
+    {Py_tp_new, (void*)node_new},
+    {Py_tp_methods, node_methods},
+    {Py_tp_richcompare, (void*)node_richcompare},
+    {Py_tp_repr, (void*)node_repr},
+    {Py_tp_str, (void*)node_repr},
+    {Py_mp_subscript, (void*)node_get_annotation},
+    {Py_mp_ass_subscript, (void*)node_set_annotation},
+    {Py_sq_contains, (void*)node_has_annotation},
+    {0, nullptr}
+};
+
+/**
+ * Implements deserialize(data), returning a proxy for the root of the C++
+ * tree deserialized from the given CBOR bytes-like object.
+ */
+static PyObject *module_deserialize(PyObject*, PyObject *data) {
+    try {
+        Py_buffer buffer;
+        if (PyObject_GetBuffer(data, &buffer, PyBUF_SIMPLE) < 0) {
+            throw PythonError();
+        }
+        std::string cbor(static_cast<const char*>(buffer.buf), (size_t)buffer.len);
+        PyBuffer_Release(&buffer);
+        try {
+            return wrap(support::base::deserialize<Node>(cbor).get_ptr());
+        } catch (const support::base::NotWellFormed&) {
+            throw;
+        } catch (const std::runtime_error &e) {
+            PyErr_SetString(PyExc_ValueError, e.what());
+            throw PythonError();
+        }
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Implements from_python(tree), returning a proxy for a C++ copy of the
+ * given tree built from the pure-Python node classes.
+ */
+static PyObject *module_from_python(PyObject *self, PyObject *tree) {
+    try {
+        auto data = check(PyObject_CallMethod(tree, "serialize", nullptr));
+        return module_deserialize(self, data.get());
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Functions of the module.
+ */
+static PyMethodDef module_methods[] = {
+    {"deserialize", (PyCFunction)module_deserialize, METH_O, "Deserializes a C++ tree from CBOR and returns a proxy for its root."},
+    {"from_python", (PyCFunction)module_from_python, METH_O, "Returns a proxy for a C++ copy of the given pure-Python tree."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+/**
+ * Creates a proxy type from the given specification with the given base
+ * type, if any.
+ */
+static PyTypeObject *create_type(PyType_Spec *spec, PyTypeObject *base) {
+    Ref bases;
+    if (base) {
+        bases = check(PyTuple_Pack(1, (PyObject*)base));
+    }
+    return (PyTypeObject*)check(PyType_FromSpecWithBases(spec, bases.get())).release();
+}
+
+/**
+ * Returns the value of the given Python expression, evaluated in the
+ * namespace of the pure-Python module.
+ */
+static PyObject *evaluate(const char *expression) {
+    auto globals = PyModule_GetDict(state.module);
+    return check(PyRun_String(expression, Py_eval_input, globals, globals)).release();
+}
+
+)CPP";
+
+    // Generate the primitive conversion functions, which depend on the
+    // serialization functions of the specification.
+    cpp::format_doc(
+        source,
+        "Converts the given C++ primitive to an instance of the Python "
+        "primitive type with the given index.");
+    source << "template <class T>" << std::endl;
+    source << "static PyObject *primitive_to_python(const T &value, size_t prim) {" << std::endl;
+    source << "    std::ostringstream ss;" << std::endl;
+    source << "    support::cbor::Writer writer{ss};" << std::endl;
+    source << "    auto map = writer.start();" << std::endl;
+    source << "    " << specification.serialize_fn << "<T>(value, map);" << std::endl;
+    source << "    map.close();" << std::endl;
+    source << "    return load_primitive(ss.str(), prim);" << std::endl;
+    source << "}" << std::endl << std::endl;
+    cpp::format_doc(
+        source,
+        "Converts the given Python object to a C++ primitive, typecasting it "
+        "to the Python primitive type with the given index first if needed. "
+        "None or null (for deleted attributes) yields the default value.");
+    source << "template <class T>" << std::endl;
+    source << "static T primitive_from_python(PyObject *value, size_t prim) {" << std::endl;
+    source << "    if (!value || value == Py_None) {" << std::endl;
+    source << "        return " << specification.initialize_function << "<T>();" << std::endl;
+    source << "    }" << std::endl;
+    source << "    support::cbor::Reader reader{dump_primitive(value, prim)};" << std::endl;
+    source << "    return " << specification.deserialize_fn << "<T>(reader.as_map());" << std::endl;
+    source << "}" << std::endl << std::endl;
+
+    // Generate the proxy types.
+    for (const auto &node : nodes) {
+        generate_type(source, module_name, *node, primitives);
+    }
+    cpp::format_doc(source, "Specification of the Node proxy type.");
+    source << "static PyType_Spec node_spec = {" << std::endl;
+    source << "    \"" << module_name << ".Node\"," << std::endl;
+    source << "    sizeof(Proxy)," << std::endl;
+    source << "    0," << std::endl;
+    source << "    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE," << std::endl;
+    source << "    node_slots" << std::endl;
+    source << "};" << std::endl << std::endl;
+    cpp::format_doc(source, "Specification of the EdgeList type.");
+    source << "static PyType_Spec edge_list_spec = {" << std::endl;
+    source << "    \"" << module_name << ".EdgeList\"," << std::endl;
+    source << "    sizeof(EdgeList)," << std::endl;
+    source << "    0," << std::endl;
+    source << "    Py_TPFLAGS_DEFAULT," << std::endl;
+    source << "    edge_list_slots" << std::endl;
+    source << "};" << std::endl << std::endl;
+    cpp::format_doc(source, "Creates the proxy types, parents before children.");
+    source << "static void create_types() {" << std::endl;
+    source << "    state.types[NODE_INDEX] = create_type(&node_spec, nullptr);" << std::endl;
+    for (const auto &node : nodes) {
+        source << "    state.types[" << get_index_name(*node) << "] = create_type(&";
+        source << node->snake_case_name << "_spec, state.types[";
+        source << (node->parent ? get_index_name(*node->parent) : "NODE_INDEX") << "]);" << std::endl;
+    }
+    source << "    state.edge_list = create_type(&edge_list_spec, nullptr);" << std::endl;
+    source << "}" << std::endl << std::endl;
+
+    // Generate the module initialization.
+    cpp::format_doc(source, "Definition of the module.");
+    source << "static PyModuleDef module_def = {" << std::endl;
+    source << "    PyModuleDef_HEAD_INIT," << std::endl;
+    source << "    MODULE_NAME," << std::endl;
+    source << "    " << c_string(
+        "Python bindings for the C++ tree defined in " + tree_header + ". "
+        "Node objects are proxies for C++ nodes; they have the same "
+        "attributes as the classes of the " + python_module_name + " module, "
+        "but no serialization happens when accessing or modifying them.") << "," << std::endl;
+    source << "    -1," << std::endl;
+    source << "    module_methods," << std::endl;
+    source << "    nullptr," << std::endl;
+    source << "    nullptr," << std::endl;
+    source << "    nullptr," << std::endl;
+    source << "    nullptr" << std::endl;
+    source << "};" << std::endl << std::endl;
+    source << R"CPP(/**
+ * Creates the module, setting up the state and types when this is first
+ * done.
+ */
+static PyObject *init_module() {
+    try {
+        auto module = check(PyModule_Create(&module_def));
+        if (!state.module) {
+            state.module = check(PyImport_ImportModule(PYTHON_MODULE_NAME)).release();
+            for (size_t prim = 0; PRIMITIVE_NAMES[prim]; prim++) {
+                state.primitives[prim] = evaluate(PRIMITIVE_NAMES[prim]);
+            }
+            if (SERIALIZE_FN) {
+                state.serialize_fn = evaluate(SERIALIZE_FN);
+            }
+            if (DESERIALIZE_FN) {
+                state.deserialize_fn = evaluate(DESERIALIZE_FN);
+            }
+            state.cbor_to_py = evaluate("_cbor_to_py");
+            state.py_to_cbor = evaluate("_py_to_cbor");
+            state.not_well_formed = evaluate("NotWellFormed");
+            state.node_class = evaluate("Node");
+            create_types();
+        }
+        for (size_t index = 0; index < TYPE_COUNT; index++) {
+            auto type = (PyObject*)state.types[index];
+            auto name = check(PyObject_GetAttrString(type, "__name__"));
+            auto name_str = PyUnicode_AsUTF8(name.get());
+            if (!name_str) {
+                throw PythonError();
+            }
+            Py_INCREF(type);
+            if (PyModule_AddObject(module.get(), name_str, type) < 0) {
+                Py_DECREF(type);
+                throw PythonError();
+            }
+        }
+        Py_INCREF(state.edge_list);
+        if (PyModule_AddObject(module.get(), "EdgeList", (PyObject*)state.edge_list) < 0) {
+            Py_DECREF(state.edge_list);
+            throw PythonError();
+        }
+        Py_INCREF(state.not_well_formed);
+        if (PyModule_AddObject(module.get(), "NotWellFormed", state.not_well_formed) < 0) {
+            Py_DECREF(state.not_well_formed);
+            throw PythonError();
+        }
+        return module.release();
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Imports this module if this hasn't been done yet, such that the state is
+ * set up. Throws PythonError on failure.
+ */
+static void ensure_initialized() {
+    if (!state.module) {
+        check(PyImport_ImportModule(MODULE_NAME));
+    }
+}
+
+/**
+ * Returns a new reference to a Python proxy object for the given node, or to
+ * None if it is empty.
+ */
+PyObject *to_proxy(const Maybe<Node> &node) {
+    try {
+        ensure_initialized();
+        return wrap(node.get_ptr());
+    } catch (...) {
+        return translate_exception();
+    }
+}
+
+/**
+ * Returns the node wrapped by the given Python proxy object, or an empty
+ * Maybe if the object is None.
+ */
+Maybe<Node> from_proxy(PyObject *object) {
+    try {
+        ensure_initialized();
+        return Maybe<Node>(unwrap(object, NODE_INDEX, "node", true));
+    } catch (...) {
+        translate_exception();
+        return Maybe<Node>();
+    }
+}
+
+)CPP";
+    source << "} // namespace python" << std::endl;
+    for (auto name_it = specification.namespaces.rbegin(); name_it != specification.namespaces.rend(); name_it++) {
+        source << "} // namespace " << *name_it << std::endl;
+    }
+    source << std::endl;
+    cpp::format_doc(source, "Entry point of the " + module_name + " extension module.");
+    source << "PyMODINIT_FUNC PyInit_" << module_name << "(void) {" << std::endl;
+    source << "    return ";
+    for (auto &name : specification.namespaces) {
+        source << name << "::";
+    }
+    source << "python::init_module();" << std::endl;
+    source << "}" << std::endl;
+
+    // Write the files if they changed.
+    write_if_changed(header_filename, header.str());
+    write_if_changed(source_filename, source.str());
+
+}
+
+} // namespace bindings
+} // namespace tree_gen
@@ -0,0 +1,35 @@
+/** \file
+ * Header file for tree-gen-bindings.cpp.
+ */
+
+#ifndef _TREE_GEN_BINDINGS_HPP_INCLUDED_
+#define _TREE_GEN_BINDINGS_HPP_INCLUDED_
+
+#include "tree-gen.hpp"
+
+namespace tree_gen {
+
+/**
+ * Namespace for the generation of Python bindings for the C++ node classes.
+ */
+namespace bindings {
+
+/**
+ * Generates the header and source file of a CPython extension module that
+ * exposes the C++ node classes generated into the given header file to
+ * Python. The module is named after the source file, without its extension.
+ * python_filename must be the Python file generated for the same
+ * specification; the module generated into it is used to convert primitives.
+ */
+void generate(
+    const std::string &header_filename,
+    const std::string &source_filename,
+    const std::string &tree_header_filename,
+    const std::string &python_filename,
+    Specification &specification
+);
+
+} // namespace bindings
+} // namespace tree_gen
+
+#endif
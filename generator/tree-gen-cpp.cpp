@@ -3,9 +3,18 @@
  */
 
 #include <fstream>
+#include <sstream>
 #include <iostream>
 #include <cctype>
+#include <cstdint>
+#include <iomanip>
 #include <unordered_set>
+#include <unordered_map>
+#include <set>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
 #include "tree-gen-cpp.hpp"
 
 namespace tree_gen {
@@ -15,10 +24,10 @@ namespace cpp {
  * Formats a C++ docstring.
  */
 void format_doc(
-    std::ofstream &stream,
+    std::ostream &stream,
     const std::string &doc,
-    const std::string &indent = "",
-    const std::string &annotation = ""
+    const std::string &indent,
+    const std::string &annotation
 ) {
     stream << indent << "/**";
     if (!annotation.empty()) {
@@ -64,7 +73,7 @@ void format_doc(
  * Generates the node type enumeration.
  */
 void generate_enum(
-    std::ofstream &header,
+    std::ostream &header,
     Nodes &nodes
 ) {
 
@@ -94,11 +103,12 @@ void generate_enum(
  * Generates an `as_<type>` function.
  */
 void generate_typecast_function(
-    std::ofstream &header,
-    std::ofstream &source,
+    std::ostream &header,
+    std::ostream &source,
     const std::string &clsname,
     Node &into,
-    bool allowed
+    bool allowed,
+    bool is_final = false
 ) {
     for (int constant = 0; constant < 2; constant++) {
         std::string doc = "Interprets this node to a node of type "
@@ -111,7 +121,7 @@ void generate_typecast_function(
         header << into.title_case_name << " *";
         header << "as_" << into.snake_case_name << "()";
         if (constant) header << " const";
-        if (allowed) header << " override";
+        if (allowed) header << (is_final ? " override final" : " override");
         header << ";" << std::endl << std::endl;
         format_doc(source, doc);
         if (constant) source << "const ";
@@ -130,14 +140,156 @@ void generate_typecast_function(
     }
 }
 
+/**
+ * Appends the CBOR encoding of the given UTF8 string to the given buffer.
+ */
+void append_cbor_string(std::string &buffer, const std::string &value) {
+    if (value.size() < 24) {
+        buffer.push_back(static_cast<char>(0x60 | value.size()));
+    } else if (value.size() < 0x100) {
+        buffer.push_back(static_cast<char>(0x78));
+        buffer.push_back(static_cast<char>(value.size()));
+    } else {
+        buffer.push_back(static_cast<char>(0x79));
+        buffer.push_back(static_cast<char>(value.size() >> 8));
+        buffer.push_back(static_cast<char>(value.size()));
+    }
+    buffer.append(value);
+}
+
+/**
+ * Returns the preset dictionary for compressed serialization of trees
+ * conforming to the given nodes. This consists of the CBOR fragments that
+ * the serializer emits over and over again: edge headers, type names, and
+ * field names.
+ */
+std::string generate_compression_dictionary(Nodes &nodes) {
+    std::string dictionary;
+
+    // Field names followed by the start of their edge map.
+    std::unordered_set<std::string> fields;
+    for (auto &node : nodes) {
+        for (auto &field : node->fields) {
+            if (!fields.insert(field.name).second) {
+                continue;
+            }
+            append_cbor_string(dictionary, field.name);
+            dictionary.push_back(static_cast<char>(0xBF));
+            auto type = (field.type == Prim) ? field.ext_type : field.type;
+            std::string edge;
+            switch (type) {
+                case Maybe:   edge = "?"; break;
+                case One:     edge = "1"; break;
+                case Any:     edge = "*"; break;
+                case Many:    edge = "+"; break;
+                case OptLink: edge = "@"; break;
+                case Link:    edge = "$"; break;
+                default: continue;
+            }
+            append_cbor_string(dictionary, "@T");
+            append_cbor_string(dictionary, edge);
+        }
+    }
+
+    // Node type names.
+    for (auto &node : nodes) {
+        if (node->derived.empty()) {
+            append_cbor_string(dictionary, "@t");
+            append_cbor_string(dictionary, node->title_case_name);
+        }
+    }
+
+    // The most common edge structures.
+    for (const auto &edge : {"?", "*", "+", "1"}) {
+        dictionary.push_back(static_cast<char>(0xBF));
+        append_cbor_string(dictionary, "@T");
+        append_cbor_string(dictionary, edge);
+        append_cbor_string(dictionary, "@i");
+    }
+    append_cbor_string(dictionary, "@d");
+    dictionary.push_back(static_cast<char>(0x9F));
+    dictionary.push_back(static_cast<char>(0xBF));
+    append_cbor_string(dictionary, "@l");
+    append_cbor_string(dictionary, "@t");
+    dictionary.push_back(static_cast<char>(0xF6));
+    dictionary.push_back(static_cast<char>(0xFF));
+    dictionary.push_back(static_cast<char>(0xFF));
+
+    return dictionary;
+}
+
+/**
+ * Returns a fingerprint of the structure of the given nodes: a 64-bit FNV-1a
+ * hash of a textual description of the node types, their hierarchy, and
+ * their fields. Documentation does not affect the fingerprint.
+ */
+uint64_t generate_schema_fingerprint(Nodes &nodes) {
+    std::ostringstream ss;
+    for (auto &node : nodes) {
+        ss << "node " << node->title_case_name;
+        if (node->parent) {
+            ss << " : " << node->parent->title_case_name;
+        }
+        if (node->is_error_marker) {
+            ss << " error";
+        }
+        ss << " {";
+        for (auto &field : node->fields) {
+            ss << " " << field.name << " " << static_cast<int>(field.type);
+            if (field.type == Prim) {
+                ss << " " << field.prim_type << " " << static_cast<int>(field.ext_type);
+            } else {
+                ss << " " << field.node_type->title_case_name;
+            }
+            ss << ";";
+        }
+        ss << " }" << std::endl;
+    }
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : ss.str()) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Formats the given binary string as a C++ string literal, broken up over
+ * multiple lines. Octal escapes are used for everything except alphanumerals
+ * so the output never depends on what follows an escape sequence.
+ */
+void format_binary_literal(
+    std::ostream &stream,
+    const std::string &data,
+    const std::string &indent = ""
+) {
+    const size_t bytes_per_line = 16;
+    for (size_t i = 0; i < data.size(); i += bytes_per_line) {
+        stream << indent << "\"";
+        for (size_t j = i; j < data.size() && j < i + bytes_per_line; j++) {
+            auto c = static_cast<unsigned char>(data[j]);
+            if (std::isalnum(c)) {
+                stream << c;
+            } else {
+                stream << "\\";
+                stream << static_cast<char>('0' + ((c >> 6) & 7));
+                stream << static_cast<char>('0' + ((c >> 3) & 7));
+                stream << static_cast<char>('0' + (c & 7));
+            }
+        }
+        stream << "\"" << std::endl;
+    }
+}
+
 /**
  * Generates the base class for the nodes.
  */
 void generate_base_class(
-    std::ofstream &header,
-    std::ofstream &source,
+    std::ostream &header,
+    std::ostream &source,
     Nodes &nodes,
     bool with_serdes,
+    bool compact_location,
     const std::string &support_ns
 ) {
 
@@ -145,8 +297,76 @@ void generate_base_class(
     header << "class Node : public Base {" << std::endl;
     header << "public:" << std::endl << std::endl;
 
+    header << "protected:" << std::endl << std::endl;
+
+    format_doc(
+        header,
+        "The `NodeType` of this node, set by the constructor of the leaf "
+        "class. Storing it here allows `type()` to be inlined rather than "
+        "requiring a virtual call.",
+        "    "
+    );
+    header << "    NodeType type_tag{};" << std::endl << std::endl;
+
+    format_doc(header, "Set for the shared instances returned by `shared()`.", "    ");
+    header << "    " << support_ns << "::base::SharedFlag shared_flag;" << std::endl << std::endl;
+
+    if (compact_location) {
+        format_doc(header, "The source location of this node.", "    ");
+        header << "    " << support_ns << "::location::SourceLocation location_slot;" << std::endl << std::endl;
+    }
+
+    header << "public:" << std::endl << std::endl;
+
+    format_doc(
+        header,
+        "Returns whether this is the shared instance of a field-less node "
+        "type, as returned by its `shared()` function.",
+        "    "
+    );
+    header << "    bool is_shared() const {" << std::endl;
+    header << "        return shared_flag;" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
     format_doc(header, "Returns the `NodeType` of this node.", "    ");
-    header << "    virtual NodeType type() const = 0;" << std::endl << std::endl;
+    header << "    NodeType type() const {" << std::endl;
+    header << "        return type_tag;" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
+    if (compact_location) {
+        format_doc(header, "Returns the source location of this node.", "    ");
+        header << "    const " << support_ns << "::location::SourceLocation &get_location() const {" << std::endl;
+        header << "        return location_slot;" << std::endl;
+        header << "    }" << std::endl << std::endl;
+
+        format_doc(header, "Sets the source location of this node.", "    ");
+        header << "    void set_location(const " << support_ns << "::location::SourceLocation &location) {" << std::endl;
+        header << "        location_slot = location;" << std::endl;
+        header << "    }" << std::endl << std::endl;
+
+        format_doc(header, "Returns the source location slot of this node.", "    ");
+        header << "    " << support_ns << "::location::SourceLocation *get_location_slot() override {" << std::endl;
+        header << "        return &location_slot;" << std::endl;
+        header << "    }" << std::endl << std::endl;
+
+        format_doc(header, "Returns the source location slot of this node.", "    ");
+        header << "    const " << support_ns << "::location::SourceLocation *get_location_slot() const override {" << std::endl;
+        header << "        return &location_slot;" << std::endl;
+        header << "    }" << std::endl << std::endl;
+    }
+
+    bool may_contain_links = false;
+    for (auto &node : nodes) {
+        may_contain_links |= node->may_contain_links;
+    }
+    format_doc(
+        header,
+        "Whether a tree rooted at a node of this type can contain links. If "
+        "not, serialization doesn't need to register the nodes up front.",
+        "    "
+    );
+    header << "    static constexpr bool MAY_CONTAIN_LINKS = ";
+    header << (may_contain_links ? "true" : "false") << ";" << std::endl << std::endl;
 
     format_doc(header, "Returns a shallow copy of this node.", "    ");
     header << "    virtual One<Node> copy() const = 0;" << std::endl << std::endl;
@@ -157,6 +377,9 @@ void generate_base_class(
     format_doc(header, "Value-based equality operator. Ignores annotations!", "    ");
     header << "    virtual bool equals(const Node& rhs) const = 0;" << std::endl << std::endl;
 
+    format_doc(header, "Adds the memory used by this node and its children to the given report.", "    ");
+    header << "    virtual void memory_usage(" << support_ns << "::base::MemoryReport &report) const = 0;" << std::endl << std::endl;
+
     format_doc(header, "Pointer-based equality operator.", "    ");
     header << "    virtual bool operator==(const Node& rhs) const = 0;" << std::endl << std::endl;
 
@@ -236,6 +459,30 @@ void generate_base_class(
         }
         source << "    throw std::runtime_error(\"Schema validation failed: unexpected node type \" + type);" << std::endl;
         source << "}" << std::endl << std::endl;
+
+        auto fingerprint_doc = "Returns a fingerprint of the structure of the tree description "
+                               "that this tree was generated from. Serialized trees that carry a "
+                               "matching fingerprint need not be validated again when deserialized.";
+        format_doc(header, fingerprint_doc, "    ");
+        header << "    static uint64_t schema_fingerprint();" << std::endl << std::endl;
+        format_doc(source, fingerprint_doc);
+        source << "uint64_t Node::schema_fingerprint() {" << std::endl;
+        source << "    return 0x" << std::hex << generate_schema_fingerprint(nodes) << std::dec << "ull;" << std::endl;
+        source << "}" << std::endl << std::endl;
+
+        auto dictionary = generate_compression_dictionary(nodes);
+        auto doc = "Returns the preset dictionary used for compressed serialization of "
+                   "trees of this type, derived from the tree schema.";
+        format_doc(header, doc, "    ");
+        header << "    static const std::string &compression_dictionary();" << std::endl << std::endl;
+        format_doc(source, doc);
+        source << "const std::string &Node::compression_dictionary() {" << std::endl;
+        source << "    static const std::string dictionary(" << std::endl;
+        format_binary_literal(source, dictionary, "        ");
+        source << "        , " << dictionary.size() << std::endl;
+        source << "    );" << std::endl;
+        source << "    return dictionary;" << std::endl;
+        source << "}" << std::endl << std::endl;
     }
 
     header << "};" << std::endl << std::endl;
@@ -247,7 +494,7 @@ void generate_base_class(
  * derived from the given node class.
  */
 void generate_deserialize_mux(
-    std::ofstream &source,
+    std::ostream &source,
     Node &node
 ) {
     if (node.derived.empty()) {
@@ -260,23 +507,99 @@ void generate_deserialize_mux(
     }
 }
 
+/**
+ * Returns an estimate of the alignment of the member generated for the given
+ * field. Edges and cold fields are pointer-aligned. For primitives, the
+ * builtin and <cstdint> types are recognized; anything else is assumed to be
+ * pointer-aligned, which is the most likely alignment for a class type.
+ */
+size_t estimate_alignment(const Field &field) {
+    if (field.type != Prim || field.ext_type != Prim || field.cold) {
+        return sizeof(void*);
+    }
+    auto type = field.prim_type;
+    if (type.compare(0, 5, "std::") == 0) {
+        type = type.substr(5);
+    } else if (type.compare(0, 2, "::") == 0) {
+        type = type.substr(2);
+    }
+    static const std::map<std::string, size_t> known = {
+        {"bool", 1}, {"char", 1}, {"signed char", 1}, {"unsigned char", 1},
+        {"int8_t", 1}, {"uint8_t", 1},
+        {"short", 2}, {"unsigned short", 2}, {"char16_t", 2},
+        {"int16_t", 2}, {"uint16_t", 2},
+        {"int", 4}, {"unsigned", 4}, {"unsigned int", 4}, {"float", 4},
+        {"char32_t", 4}, {"int32_t", 4}, {"uint32_t", 4},
+    };
+    auto it = known.find(type);
+    if (it != known.end()) {
+        return it->second;
+    }
+    return sizeof(void*);
+}
+
+/**
+ * Returns the fields declared by the given node in the order in which they
+ * should be stored in the class. This is the declaration order, unless layout
+ * optimization is enabled, in which case they are sorted by decreasing
+ * alignment to minimize padding.
+ */
+std::vector<Field> get_storage_order(const Specification &spec, const Node &node) {
+    auto fields = node.fields;
+    if (spec.optimize_layout) {
+        std::stable_sort(
+            fields.begin(), fields.end(),
+            [](const Field &a, const Field &b) {
+                return estimate_alignment(a) > estimate_alignment(b);
+            }
+        );
+    }
+    return fields;
+}
+
+/**
+ * Returns the name of the edge template used for the given One field.
+ */
+std::string get_one_edge(const Specification &spec, const Field &field) {
+    if (field.is_inline) {
+        return spec.support_namespace + "::base::Inline";
+    }
+    return "One";
+}
+
+/**
+ * Returns the expression for reading the value of the given field of a node,
+ * taking cold fields into account.
+ */
+std::string get_field_value(const Field &field) {
+    if (field.cold) {
+        return field.name + ".get()";
+    }
+    return field.name;
+}
+
 /**
  * Generates the class for the given node.
  */
 void generate_node_class(
-    std::ofstream &header,
-    std::ofstream &source,
+    std::ostream &header,
+    std::ostream &source,
     Specification &spec,
     Node &node
 ) {
     const auto all_fields = node.all_fields();
+    const auto storage_fields = get_storage_order(spec, node);
     const auto &support_ns = spec.support_namespace;
 
     // Print class header.
     if (!node.doc.empty()) {
         format_doc(header, node.doc);
     }
-    header << "class " << node.title_case_name << " : public ";
+    header << "class " << node.title_case_name;
+    if (node.derived.empty()) {
+        header << " final";
+    }
+    header << " : public ";
     if (node.parent) {
         header << node.parent->title_case_name;
     } else {
@@ -285,25 +608,66 @@ void generate_node_class(
     header << " {" << std::endl;
     header << "public:" << std::endl << std::endl;
 
+    // Print reachability information.
+    format_doc(
+        header,
+        "Whether a tree rooted at a node of this type can contain links. If "
+        "not, serialization doesn't need to register the nodes up front.",
+        "    "
+    );
+    header << "    static constexpr bool MAY_CONTAIN_LINKS = ";
+    header << (node.may_contain_links ? "true" : "false") << ";" << std::endl << std::endl;
+
     // Print fields.
-    for (auto &field : node.fields) {
+    for (auto &field : storage_fields) {
         if (!field.doc.empty()) {
             format_doc(header, field.doc, "    ");
         }
         header << "    ";
         switch (field.type) {
             case Maybe:   header << "Maybe<"   << field.node_type->title_case_name << "> "; break;
-            case One:     header << "One<"     << field.node_type->title_case_name << "> "; break;
+            case One:     header << get_one_edge(spec, field) << "<" << field.node_type->title_case_name << "> "; break;
             case Any:     header << "Any<"     << field.node_type->title_case_name << "> "; break;
             case Many:    header << "Many<"    << field.node_type->title_case_name << "> "; break;
             case OptLink: header << "OptLink<" << field.node_type->title_case_name << "> "; break;
             case Link:    header << "Link<"    << field.node_type->title_case_name << "> "; break;
-            case Prim:    header << field.prim_type << " "; break;
+            case Prim:
+                if (field.cold) {
+                    header << support_ns << "::base::Cold<" << field.prim_type << "> ";
+                } else {
+                    header << field.prim_type << " ";
+                }
+                break;
         }
         header << field.name << ";" << std::endl << std::endl;
     }
 
-    // Print constructors.
+    // Print constructors. Leaf classes always need one to set the type tag.
+    if (all_fields.empty() && node.derived.empty()) {
+        format_doc(header, "Constructor.", "    ");
+        header << "    " << node.title_case_name << "();" << std::endl << std::endl;
+        format_doc(source, "Constructor.", "");
+        source << node.title_case_name << "::" << node.title_case_name << "() {" << std::endl;
+        source << "    type_tag = NodeType::" << node.title_case_name << ";" << std::endl;
+        source << "}" << std::endl << std::endl;
+
+        auto doc = "Returns the shared instance of this node type. As the node has no "
+                   "fields, a single instance can be used everywhere instead of allocating "
+                   "a new node each time; it may appear any number of times in a tree. "
+                   "The shared instance must not be modified, which includes setting "
+                   "annotations on it, and it can't be the target of a link.";
+        format_doc(header, doc, "    ");
+        header << "    static One<" << node.title_case_name << "> shared();" << std::endl << std::endl;
+        format_doc(source, doc);
+        source << "One<" << node.title_case_name << "> " << node.title_case_name << "::shared() {" << std::endl;
+        source << "    static const std::shared_ptr<" << node.title_case_name << "> instance = []() {" << std::endl;
+        source << "        auto node = std::make_shared<" << node.title_case_name << ">();" << std::endl;
+        source << "        node->shared_flag.set();" << std::endl;
+        source << "        return node;" << std::endl;
+        source << "    }();" << std::endl;
+        source << "    return One<" << node.title_case_name << ">(instance);" << std::endl;
+        source << "}" << std::endl << std::endl;
+    }
     if (!all_fields.empty()) {
         format_doc(header, "Constructor.", "    ");
         header << "    " << node.title_case_name << "(";
@@ -317,7 +681,7 @@ void generate_node_class(
             header << "const ";
             switch (field.type) {
                 case Maybe:   header << "Maybe<"   << field.node_type->title_case_name << "> "; break;
-                case One:     header << "One<"     << field.node_type->title_case_name << "> "; break;
+                case One:     header << get_one_edge(spec, field) << "<" << field.node_type->title_case_name << "> "; break;
                 case Any:     header << "Any<"     << field.node_type->title_case_name << "> "; break;
                 case Many:    header << "Many<"    << field.node_type->title_case_name << "> "; break;
                 case OptLink: header << "OptLink<" << field.node_type->title_case_name << "> "; break;
@@ -327,7 +691,7 @@ void generate_node_class(
             header << "&" << field.name << " = ";
             switch (field.type) {
                 case Maybe:   header << "Maybe<"   << field.node_type->title_case_name << ">()"; break;
-                case One:     header << "One<"     << field.node_type->title_case_name << ">()"; break;
+                case One:     header << get_one_edge(spec, field) << "<" << field.node_type->title_case_name << ">()"; break;
                 case Any:     header << "Any<"     << field.node_type->title_case_name << ">()"; break;
                 case Many:    header << "Many<"    << field.node_type->title_case_name << ">()"; break;
                 case OptLink: header << "OptLink<" << field.node_type->title_case_name << ">()"; break;
@@ -349,7 +713,7 @@ void generate_node_class(
             source << "const ";
             switch (field.type) {
                 case Maybe:   source << "Maybe<" << field.node_type->title_case_name << "> "; break;
-                case One:     source << "One<" << field.node_type->title_case_name << "> "; break;
+                case One:     source << get_one_edge(spec, field) << "<" << field.node_type->title_case_name << "> "; break;
                 case Any:     source << "Any<" << field.node_type->title_case_name << "> "; break;
                 case Many:    source << "Many<" << field.node_type->title_case_name << "> "; break;
                 case OptLink: source << "OptLink<" << field.node_type->title_case_name << "> "; break;
@@ -374,7 +738,7 @@ void generate_node_class(
             source << ")";
             first = false;
         }
-        for (auto &field : node.fields) {
+        for (auto &field : storage_fields) {
             if (first) {
                 first = false;
             } else {
@@ -382,14 +746,20 @@ void generate_node_class(
             }
             source << field.name << "(" << field.name << ")";
         }
-        source << std::endl << "{}" << std::endl << std::endl;
+        if (node.derived.empty()) {
+            source << std::endl << "{" << std::endl;
+            source << "    type_tag = NodeType::" << node.title_case_name << ";" << std::endl;
+            source << "}" << std::endl << std::endl;
+        } else {
+            source << std::endl << "{}" << std::endl << std::endl;
+        }
     }
 
     // Print find_reachable and check_complete functions.
     if (node.derived.empty()) {
         std::string doc = "Registers all reachable nodes with the given PointerMap.";
         format_doc(header, doc, "    ");
-        header << "    void find_reachable(" << support_ns << "::base::PointerMap &map) const override;" << std::endl << std::endl;
+        header << "    void find_reachable(" << support_ns << "::base::PointerMap &map) const override final;" << std::endl << std::endl;
         format_doc(source, doc);
         source << "void " << node.title_case_name;
         source << "::find_reachable(" << support_ns << "::base::PointerMap &map) const {" << std::endl;
@@ -413,7 +783,7 @@ void generate_node_class(
 
         doc = "Returns whether this `" + node.title_case_name + "` is complete/fully defined.";
         format_doc(header, doc, "    ");
-        header << "    void check_complete(const " << support_ns << "::base::PointerMap &map) const override;" << std::endl << std::endl;
+        header << "    void check_complete(const " << support_ns << "::base::PointerMap &map) const override final;" << std::endl << std::endl;
         format_doc(source, doc);
         source << "void " << node.title_case_name;
         source << "::check_complete(const " << support_ns << "::base::PointerMap &map) const {" << std::endl;
@@ -422,12 +792,27 @@ void generate_node_class(
             source << "    throw " << support_ns << "::base::NotWellFormed(\"" << node.title_case_name << " error node in tree\");" << std::endl;
         } else {
             for (auto &field : all_fields) {
+
+                // Subtrees that can't be incomplete are skipped entirely;
+                // only the edge itself and the One entries of Any and Many
+                // edges may still need to be checked for emptiness.
+                bool recurse = !field.node_type || field.node_type->may_be_incomplete;
                 auto type = (field.type == Prim) ? field.ext_type : field.type;
                 switch (type) {
                     case Maybe:
+                        if (recurse) {
+                            source << "    " << field.name << ".check_complete(map);" << std::endl;
+                        }
+                        break;
                     case One:
                     case Any:
                     case Many:
+                        if (recurse) {
+                            source << "    " << field.name << ".check_complete(map);" << std::endl;
+                        } else if (!field.is_inline) {
+                            source << "    " << field.name << ".check_not_empty();" << std::endl;
+                        }
+                        break;
                     case OptLink:
                     case Link:
                         source << "    " << field.name << ".check_complete(map);" << std::endl;
@@ -440,24 +825,12 @@ void generate_node_class(
         source << "}" << std::endl << std::endl;
     }
 
-    // Print type() function.
-    if (node.derived.empty()) {
-        auto doc = "Returns the `NodeType` of this node.";
-        format_doc(header, doc, "    ");
-        header << "    NodeType type() const override;" << std::endl << std::endl;
-        format_doc(source, doc);
-        source << "NodeType " << node.title_case_name;
-        source << "::type() const {" << std::endl;
-        source << "    return NodeType::" << node.title_case_name << ";" << std::endl;
-        source << "}" << std::endl << std::endl;
-    }
-
     // Print visitor function.
     if (node.derived.empty()) {
         auto doc = "Helper method for visiting nodes.";
         header << "protected:" << std::endl << std::endl;
         format_doc(header, doc, "    ");
-        header << "    void visit_internal(VisitorBase &visitor, void *retval) override;" << std::endl << std::endl;
+        header << "    void visit_internal(VisitorBase &visitor, void *retval) override final;" << std::endl << std::endl;
         header << "public:" << std::endl << std::endl;
         format_doc(source, doc);
         source << "void " << node.title_case_name;
@@ -468,13 +841,13 @@ void generate_node_class(
     }
 
     // Print conversion function.
-    generate_typecast_function(header, source, node.title_case_name, node, true);
+    generate_typecast_function(header, source, node.title_case_name, node, true, node.derived.empty());
 
     // Print copy method.
     if (node.derived.empty()) {
         auto doc = "Returns a shallow copy of this node.";
         format_doc(header, doc, "    ");
-        header << "    One<Node> copy() const override;" << std::endl << std::endl;
+        header << "    One<Node> copy() const override final;" << std::endl << std::endl;
         format_doc(source, doc);
         source << "One<Node> " << node.title_case_name;
         source << "::copy() const {" << std::endl;
@@ -490,7 +863,7 @@ void generate_node_class(
     if (node.derived.empty()) {
         auto doc = "Returns a deep copy of this node.";
         format_doc(header, doc, "    ");
-        header << "    One<Node> clone() const override;" << std::endl << std::endl;
+        header << "    One<Node> clone() const override final;" << std::endl << std::endl;
         format_doc(source, doc);
         source << "One<Node> " << node.title_case_name;
         source << "::clone() const {" << std::endl;
@@ -509,17 +882,49 @@ void generate_node_class(
         source << "}" << std::endl << std::endl;
     }
 
+    // Print memory usage method.
+    if (node.derived.empty()) {
+        auto doc = "Adds the memory used by this node and its children to the given report.";
+        format_doc(header, doc, "    ");
+        header << "    void memory_usage(" << support_ns << "::base::MemoryReport &report) const override final;" << std::endl << std::endl;
+        format_doc(source, doc);
+        source << "void " << node.title_case_name;
+        source << "::memory_usage(" << support_ns << "::base::MemoryReport &report) const {" << std::endl;
+        source << "    auto &usage = report.add_node(\"" << node.title_case_name << "\", ";
+        source << "sizeof(" << node.title_case_name << "), *this);" << std::endl;
+        for (auto &field : all_fields) {
+            auto type = (field.type == Prim) ? field.ext_type : field.type;
+            if (type == Any || type == Many) {
+                source << "    usage.edge_bytes += " << field.name << ".heap_size();" << std::endl;
+            } else if (type == Prim && !spec.heap_size_fn.empty()) {
+                source << "    usage.primitive_bytes += " << spec.heap_size_fn;
+                source << "<" << field.prim_type << ">(" << get_field_value(field) << ");" << std::endl;
+            }
+            if (field.cold) {
+                source << "    usage.primitive_bytes += " << field.name << ".heap_size();" << std::endl;
+            }
+        }
+        source << "    (void)usage;" << std::endl;
+        for (auto &field : all_fields) {
+            auto type = (field.type == Prim) ? field.ext_type : field.type;
+            if (type == Maybe || type == One || type == Any || type == Many) {
+                source << "    " << field.name << ".memory_usage(report);" << std::endl;
+            }
+        }
+        source << "}" << std::endl << std::endl;
+    }
+
     // Print equality operator.
     if (node.derived.empty()) {
         auto doc = "Value-based equality operator. Ignores annotations!";
         format_doc(header, doc, "    ");
-        header << "    bool equals(const Node &rhs) const override;" << std::endl << std::endl;
+        header << "    bool equals(const Node &rhs) const override final;" << std::endl << std::endl;
         format_doc(source, doc);
         source << "bool " << node.title_case_name;
         source << "::equals(const Node &rhs) const {" << std::endl;
         source << "    if (rhs.type() != NodeType::" << node.title_case_name << ") return false;" << std::endl;
         if (!all_fields.empty()) {
-            source << "    auto rhsc = dynamic_cast<const " << node.title_case_name << "&>(rhs);" << std::endl;
+            source << "    auto &rhsc = static_cast<const " << node.title_case_name << "&>(rhs);" << std::endl;
             for (auto &field : all_fields) {
                 if (field.type == Prim && field.ext_type == Prim) {
                     source << "    if (this->" << field.name << " != rhsc." << field.name << ") return false;" << std::endl;
@@ -533,13 +938,13 @@ void generate_node_class(
 
         doc = "Pointer-based equality operator.";
         format_doc(header, doc, "    ");
-        header << "    bool operator==(const Node &rhs) const override;" << std::endl << std::endl;
+        header << "    bool operator==(const Node &rhs) const override final;" << std::endl << std::endl;
         format_doc(source, doc);
         source << "bool " << node.title_case_name;
         source << "::operator==(const Node &rhs) const {" << std::endl;
         source << "    if (rhs.type() != NodeType::" << node.title_case_name << ") return false;" << std::endl;
         if (!all_fields.empty()) {
-            source << "    auto rhsc = dynamic_cast<const " << node.title_case_name << "&>(rhs);" << std::endl;
+            source << "    auto &rhsc = static_cast<const " << node.title_case_name << "&>(rhs);" << std::endl;
             for (auto &field : all_fields) {
                 source << "    if (this->" << field.name << " != rhsc." << field.name << ") return false;" << std::endl;
             }
@@ -555,7 +960,7 @@ void generate_node_class(
             header << "    void serialize(" << std::endl;
             header << "        " << support_ns << "::cbor::MapWriter &map," << std::endl;
             header << "        const " << support_ns << "::base::PointerMap &ids" << std::endl;
-            header << "    ) const override;" << std::endl << std::endl;
+            header << "    ) const override final;" << std::endl << std::endl;
             format_doc(source, "Serializes this node to the given map.");
             source << "void " << node.title_case_name << "::serialize(" << std::endl;
             source << "    " << support_ns << "::cbor::MapWriter &map," << std::endl;
@@ -573,7 +978,7 @@ void generate_node_class(
                 source << "submap = map.append_map(\"" << field.name << "\");" << std::endl;
                 if (field.type == Prim && field.ext_type == Prim) {
                     source << "    " << spec.serialize_fn << "<" << field.prim_type << ">";
-                    source << "(" << field.name << ", submap);" << std::endl;
+                    source << "(" << get_field_value(field) << ", submap);" << std::endl;
                 } else {
                     source << "    " << field.name << ".serialize(submap, ids);" << std::endl;
                 }
@@ -582,19 +987,28 @@ void generate_node_class(
             source << "    serialize_annotations(map);" << std::endl;
             source << "}" << std::endl << std::endl;
 
-            format_doc(header, "Deserializes the given node.", "    ");
+            auto deserialize_doc = "Deserializes the given node. Unless links is cleared, the "
+                                   "links of the node and of the nodes stored inline in it are "
+                                   "registered with ids. Nodes stored inline are deserialized "
+                                   "without, as they are copied into the node containing them, "
+                                   "which registers their links once it is in place.";
+            format_doc(header, deserialize_doc, "    ");
             header << "    static std::shared_ptr<" << node.title_case_name << "> ";
-            header << "deserialize(const " << support_ns << "::cbor::MapReader &map, " << support_ns << "::base::IdentifierMap &ids);" << std::endl << std::endl;
-            format_doc(source, "Writes a debug dump of this node to the given stream.");
+            header << "deserialize(const " << support_ns << "::cbor::MapReader &map, " << support_ns << "::base::IdentifierMap &ids, bool links = true);" << std::endl << std::endl;
+            format_doc(source, deserialize_doc);
             source << "std::shared_ptr<" << node.title_case_name << "> ";
-            source << node.title_case_name << "::deserialize(const " << support_ns << "::cbor::MapReader &map, " << support_ns << "::base::IdentifierMap &ids) {" << std::endl;
+            source << node.title_case_name << "::deserialize(const " << support_ns << "::cbor::MapReader &map, " << support_ns << "::base::IdentifierMap &ids, bool links) {" << std::endl;
             source << "    (void)ids;" << std::endl;
             source << "    auto type = map.at(\"@t\").as_string();" << std::endl;
             source << "    if (type != \"" << node.title_case_name << "\") {" << std::endl;
             source << "        throw std::runtime_error(\"Schema validation failed: unexpected node type \" + type);" << std::endl;
             source << "    }" << std::endl;
+            if (all_fields.empty()) {
+                source << "    if (map.find(\"@i\") == map.end()) {" << std::endl;
+                source << "        return shared().get_ptr();" << std::endl;
+                source << "    }" << std::endl;
+            }
             source << "    auto node = std::make_shared<" << node.title_case_name << ">(" << std::endl;
-            std::vector<Field> links{};
             first = true;
             for (const auto &field : all_fields) {
                 if (first) {
@@ -603,12 +1017,10 @@ void generate_node_class(
                     source << "," << std::endl;
                 }
                 source << "        ";
-
-                EdgeType type = (field.type != Prim) ? field.type : field.ext_type;
                 if (field.type != Prim) {
                     switch (field.type) {
                         case Maybe:   source << "Maybe"; break;
-                        case One:     source << "One"; break;
+                        case One:     source << get_one_edge(spec, field); break;
                         case Any:     source << "Any"; break;
                         case Many:    source << "Many"; break;
                         case OptLink: source << "OptLink"; break;
@@ -624,26 +1036,52 @@ void generate_node_class(
                     source << spec.deserialize_fn << "<" << field.prim_type << ">";
                     source << "(map.at(\"" << field.name << "\").as_map())";
                 }
-                if (type == OptLink || type == Link) {
-                    links.push_back(field);
-                }
             }
             source << std::endl;
             source << "    );" << std::endl;
+            source << "    if (links) {" << std::endl;
+            source << "        node->register_links(map, ids);" << std::endl;
+            source << "    }" << std::endl;
+            source << "    node->deserialize_annotations(map);" << std::endl;
+            source << "    return node;" << std::endl;
+            source << "}" << std::endl << std::endl;
+
+            auto register_doc = "Registers the links of this node and of the nodes stored "
+                                "inline in it with ids, given the map that the node was "
+                                "deserialized from. The links are registered by reference, "
+                                "so this must only be called once the node is in place.";
+            format_doc(header, register_doc, "    ");
+            header << "    void register_links(const " << support_ns << "::cbor::MapReader &map, " << support_ns << "::base::IdentifierMap &ids);" << std::endl << std::endl;
+            format_doc(source, register_doc);
+            source << "void " << node.title_case_name << "::register_links(const " << support_ns << "::cbor::MapReader &map, " << support_ns << "::base::IdentifierMap &ids) {" << std::endl;
             first = true;
-            for (const auto &link : links) {
-                source << "    ";
-                if (first) {
+            for (const auto &field : all_fields) {
+                EdgeType type = (field.type != Prim) ? field.type : field.ext_type;
+                if (field.is_inline || type == OptLink || type == Link) {
                     first = false;
-                    source << "auto ";
                 }
-                source << "link = map.at(\"" << link.name << "\").as_map().at(\"@l\");" << std::endl;
-                source << "    if (!link.is_null()) {" << std::endl;
-                source << "        ids.register_link(node->" << link.name << ", link.as_int());" << std::endl;
-                source << "    }" << std::endl;
             }
-            source << "    node->deserialize_annotations(map);" << std::endl;
-            source << "    return node;" << std::endl;
+            if (first) {
+                source << "    (void)map;" << std::endl;
+                source << "    (void)ids;" << std::endl;
+            }
+            first = true;
+            for (const auto &field : all_fields) {
+                EdgeType type = (field.type != Prim) ? field.type : field.ext_type;
+                if (field.is_inline) {
+                    source << "    " << field.name << ".register_links(map.at(\"" << field.name << "\").as_map(), ids);" << std::endl;
+                } else if (type == OptLink || type == Link) {
+                    source << "    ";
+                    if (first) {
+                        first = false;
+                        source << "auto ";
+                    }
+                    source << "link = map.at(\"" << field.name << "\").as_map().at(\"@l\");" << std::endl;
+                    source << "    if (!link.is_null()) {" << std::endl;
+                    source << "        ids.register_link(" << field.name << ", link.as_int());" << std::endl;
+                    source << "    }" << std::endl;
+                }
+            }
             source << "}" << std::endl << std::endl;
         } else {
             format_doc(header, "Deserializes the given node.", "    ");
@@ -669,8 +1107,8 @@ void generate_node_class(
  * Generate the visitor base class.
  */
 void generate_visitor_base_class(
-    std::ofstream &header,
-    std::ofstream &source,
+    std::ostream &header,
+    std::ostream &source,
     Nodes &nodes
 ) {
 
@@ -712,8 +1150,8 @@ void generate_visitor_base_class(
  * Generate the templated visitor class.
  */
 void generate_visitor_class(
-    std::ofstream &header,
-    std::ofstream &source,
+    std::ostream &header,
+    std::ostream &source,
     Nodes &nodes
 ) {
 
@@ -824,8 +1262,8 @@ void generate_visitor_class(
  * Generate the recursive visitor class.
  */
 void generate_recursive_visitor_class(
-    std::ofstream &header,
-    std::ofstream &source,
+    std::ostream &header,
+    std::ostream &source,
     Nodes &nodes
 ) {
 
@@ -867,14 +1305,354 @@ void generate_recursive_visitor_class(
     header << "};" << std::endl << std::endl;
 }
 
+/**
+ * Generate the fused visitor class and the pass manager typedef.
+ */
+void generate_fused_visitor_class(
+    std::ostream &header,
+    std::ostream &source,
+    const std::string &support_ns
+) {
+
+    // Print class header.
+    format_doc(
+        header,
+        "Recursive visitor that calls any number of other visitors for each "
+        "node, such that multiple passes can share a single traversal.\n\n"
+        "The visitors are called in the order in which they were added, and "
+        "should only handle the node they are called for, without recursing "
+        "into its children; this visitor takes care of the traversal, in DFS "
+        "pre-order. Links and OptLinks are *not* followed."
+    );
+    header << "class FusedVisitor : public RecursiveVisitor {" << std::endl;
+    header << "private:" << std::endl << std::endl;
+
+    format_doc(header, "The visitors to call for each node.", "    ");
+    header << "    std::vector<Visitor<void>*> visitors;" << std::endl << std::endl;
+
+    header << "public:" << std::endl << std::endl;
+
+    auto doc = "Adds a visitor. The visitor is not copied, so it must remain valid while this visitor is used.";
+    format_doc(header, doc, "    ");
+    header << "    void add(Visitor<void> &visitor);" << std::endl << std::endl;
+    format_doc(source, doc);
+    source << "void FusedVisitor::add(Visitor<void> &visitor) {" << std::endl;
+    source << "    visitors.push_back(&visitor);" << std::endl;
+    source << "}" << std::endl << std::endl;
+
+    doc = "Calls all visitors for the given node.";
+    format_doc(header, doc, "    ");
+    header << "    void visit_node(Node &node) override;" << std::endl << std::endl;
+    format_doc(source, doc);
+    source << "void FusedVisitor::visit_node(Node &node) {" << std::endl;
+    source << "    for (auto visitor : visitors) {" << std::endl;
+    source << "        node.visit(*visitor);" << std::endl;
+    source << "    }" << std::endl;
+    source << "}" << std::endl << std::endl;
+
+    header << "};" << std::endl << std::endl;
+
+    format_doc(
+        header,
+        "Pass manager for this tree. Visitor passes are `Visitor<void>` "
+        "instances, which are fused into as few traversals as possible using "
+        "`FusedVisitor`; function passes operate on the root node."
+    );
+    header << "using PassManager = " << support_ns << "::pass::PassManager<Node, Visitor<void>, FusedVisitor>;" << std::endl << std::endl;
+}
+
+/**
+ * Generate the memoizing visitor class.
+ */
+void generate_memo_visitor_class(
+    std::ostream &header,
+    Nodes &nodes
+) {
+
+    // Print class header.
+    format_doc(
+        header,
+        "Visitor base class that caches the result of visiting each node.\n\n"
+        "The first time a node is visited, the appropriate visit function is "
+        "called as usual, and its result is stored in a cache keyed by the "
+        "address of the node. Subsequent visits of the same node, for "
+        "instance through another link or a repeated query, return the cached "
+        "result without calling the visit function again. This is useful for "
+        "analyses such as type inference or constant folding, which would "
+        "otherwise have to maintain their own node-to-result maps.\n\n"
+        "The cache does not keep nodes alive and does not track changes to "
+        "the tree. When a node is modified, call `invalidate()` for it and for "
+        "any node whose result depends on it, or `clear()` to invalidate "
+        "everything. The same applies when a node is destroyed, as a new node "
+        "may be allocated at the same address. The result type must be "
+        "default-constructible and copyable, and can thus not be `void`."
+    );
+    header << "template <typename R>" << std::endl;
+    header << "class MemoVisitor : public Visitor<R> {" << std::endl;
+    header << "private:" << std::endl << std::endl;
+
+    format_doc(header, "The cached results.", "    ");
+    header << "    std::unordered_map<const Node*, R> cache;" << std::endl << std::endl;
+
+    format_doc(header, "Number of visits that were answered from the cache.", "    ");
+    header << "    size_t hit_count = 0;" << std::endl << std::endl;
+
+    format_doc(header, "Number of visits that were not answered from the cache.", "    ");
+    header << "    size_t miss_count = 0;" << std::endl << std::endl;
+
+    format_doc(
+        header,
+        "Returns the cached result for the given node through retval if "
+        "there is one, and otherwise computes it using the given function and "
+        "stores it.",
+        "    "
+    );
+    header << "    template <class F>" << std::endl;
+    header << "    void memoize(const Node &node, void *retval, F compute) {" << std::endl;
+    header << "        auto it = cache.find(&node);" << std::endl;
+    header << "        if (it != cache.end()) {" << std::endl;
+    header << "            hit_count++;" << std::endl;
+    header << "        } else {" << std::endl;
+    header << "            miss_count++;" << std::endl;
+    header << "            R result = compute();" << std::endl;
+    header << "            it = cache.emplace(&node, std::move(result)).first;" << std::endl;
+    header << "        }" << std::endl;
+    header << "        if (retval != nullptr) {" << std::endl;
+    header << "            *((R*)retval) = it->second;" << std::endl;
+    header << "        }" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
+    // Internal functions for all node types that can actually be visited.
+    header << "protected:" << std::endl << std::endl;
+    for (auto &node : nodes) {
+        if (!node->derived.empty()) {
+            continue;
+        }
+        format_doc(header, "Internal visitor function for `" + node->title_case_name + "` nodes.", "    ");
+        header << "    void raw_visit_" << node->snake_case_name;
+        header << "(" << node->title_case_name << " &node, void *retval) override {" << std::endl;
+        header << "        memoize(node, retval, [this, &node]() {" << std::endl;
+        header << "            return this->visit_" << node->snake_case_name << "(node);" << std::endl;
+        header << "        });" << std::endl;
+        header << "    }" << std::endl << std::endl;
+    }
+
+    header << "public:" << std::endl << std::endl;
+
+    format_doc(header, "Returns whether a result is cached for the given node.", "    ");
+    header << "    bool is_cached(const Node &node) const {" << std::endl;
+    header << "        return cache.count(&node) > 0;" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
+    format_doc(header, "Removes the cached result for the given node, if any.", "    ");
+    header << "    void invalidate(const Node &node) {" << std::endl;
+    header << "        cache.erase(&node);" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
+    format_doc(header, "Removes all cached results.", "    ");
+    header << "    void clear() {" << std::endl;
+    header << "        cache.clear();" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
+    format_doc(header, "Returns the number of cached results.", "    ");
+    header << "    size_t cache_size() const {" << std::endl;
+    header << "        return cache.size();" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
+    format_doc(header, "Returns the number of visits that were answered from the cache.", "    ");
+    header << "    size_t hits() const {" << std::endl;
+    header << "        return hit_count;" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
+    format_doc(header, "Returns the number of visits that were not answered from the cache.", "    ");
+    header << "    size_t misses() const {" << std::endl;
+    header << "        return miss_count;" << std::endl;
+    header << "    }" << std::endl << std::endl;
+
+    header << "};" << std::endl << std::endl;
+}
+
+/**
+ * Gathers the leaf node types derived from (or equal to) the given node type.
+ */
+void gather_leaves(const Node &node, std::vector<std::string> &leaves) {
+    if (node.derived.empty()) {
+        leaves.push_back(node.title_case_name);
+    }
+    for (auto &derived : node.derived) {
+        gather_leaves(*derived.lock(), leaves);
+    }
+}
+
+/**
+ * Generate the compile-time reflection information and the generic traversal
+ * functions built on top of it.
+ */
+void generate_reflection(
+    std::ostream &header,
+    Nodes &nodes,
+    const std::string &support_ns
+) {
+
+    // Generate the traits template and its specializations.
+    format_doc(
+        header,
+        "Compile-time reflection information for the node class T.\n\n"
+        "All specializations provide `name()`, returning the name of the node "
+        "type, `IS_LEAF`, and `contains(NodeType)`, which returns whether a "
+        "node of the given type is an instance of T. Specializations for leaf "
+        "types additionally provide `TYPE`, the corresponding `NodeType`, "
+        "`FIELD_COUNT`, the number of fields including inherited ones, and "
+        "`for_each_field(node, f)`, which calls `f(name, field)` for each "
+        "field of the given node in declaration order. The kind of a field "
+        "can be determined at compile time using `" + support_ns +
+        "::base::field_kind`.\n\n"
+        "Combined with `dispatch()` this allows whole-tree algorithms (hashing, "
+        "printing, statistics, and so on) to be written once as a template, "
+        "while the compiler specializes them for each node type without any "
+        "virtual calls."
+    );
+    header << "template <class T>" << std::endl;
+    header << "struct NodeTraits;" << std::endl << std::endl;
+    for (auto &node : nodes) {
+        std::vector<std::string> leaves;
+        gather_leaves(*node, leaves);
+        auto is_leaf = node->derived.empty();
+        format_doc(header, "Compile-time reflection information for `" + node->title_case_name + "` nodes.");
+        header << "template <>" << std::endl;
+        header << "struct NodeTraits<" << node->title_case_name << "> {" << std::endl << std::endl;
+        format_doc(header, "Returns the name of this node type.", "    ");
+        header << "    static constexpr const char *name() {" << std::endl;
+        header << "        return \"" << node->title_case_name << "\";" << std::endl;
+        header << "    }" << std::endl << std::endl;
+        format_doc(header, "Whether this is a leaf type, i.e. whether it can be instantiated.", "    ");
+        header << "    static constexpr bool IS_LEAF = " << (is_leaf ? "true" : "false") << ";" << std::endl << std::endl;
+        format_doc(header, "Returns whether a node of the given type is an instance of this type.", "    ");
+        header << "    static constexpr bool contains(NodeType type) {" << std::endl;
+        header << "        return ";
+        for (size_t i = 0; i < leaves.size(); i++) {
+            if (i) {
+                header << std::endl << "            || ";
+            }
+            header << "type == NodeType::" << leaves[i];
+        }
+        header << ";" << std::endl;
+        header << "    }" << std::endl << std::endl;
+        if (is_leaf) {
+            auto fields = node->all_fields();
+            format_doc(header, "The `NodeType` of this node type.", "    ");
+            header << "    static constexpr NodeType TYPE = NodeType::" << node->title_case_name << ";" << std::endl << std::endl;
+            format_doc(header, "The number of fields of this node type, including inherited fields.", "    ");
+            header << "    static constexpr size_t FIELD_COUNT = " << fields.size() << ";" << std::endl << std::endl;
+            for (auto qualifier : {"", "const "}) {
+                format_doc(header, "Calls f(name, field) for each field of the given node.", "    ");
+                header << "    template <class F>" << std::endl;
+                header << "    static void for_each_field(" << qualifier << node->title_case_name;
+                header << " &node, F &&f) {" << std::endl;
+                if (fields.empty()) {
+                    header << "        (void)node;" << std::endl;
+                    header << "        (void)f;" << std::endl;
+                }
+                for (auto &field : fields) {
+                    header << "        f(\"" << field.name << "\", node." << field.name << ");" << std::endl;
+                }
+                header << "    }" << std::endl << std::endl;
+            }
+        }
+        header << "};" << std::endl << std::endl;
+    }
+
+    // Generate the dispatch function.
+    format_doc(
+        header,
+        "Calls f with the given node, statically cast to its leaf type. This "
+        "allows f to be a functor with a templated call operator, which is "
+        "then instantiated for each leaf type."
+    );
+    header << "template <class F>" << std::endl;
+    header << "void dispatch(Node &node, F &&f) {" << std::endl;
+    header << "    switch (node.type()) {" << std::endl;
+    for (auto &node : nodes) {
+        if (!node->derived.empty()) {
+            continue;
+        }
+        header << "        case NodeType::" << node->title_case_name << ":" << std::endl;
+        header << "            f(static_cast<" << node->title_case_name << "&>(node));" << std::endl;
+        header << "            break;" << std::endl;
+    }
+    header << "    }" << std::endl;
+    header << "}" << std::endl << std::endl;
+
+    // Generate the traversal helper.
+    format_doc(header, "Helper class for for_each_node().");
+    header << "class NodeWalker {" << std::endl;
+    header << "private:" << std::endl << std::endl;
+    header << "    template <class F>" << std::endl;
+    header << "    friend void for_each_node(Node &root, F &&f);" << std::endl << std::endl;
+    format_doc(header, "Pushes nodes of this tree onto the stack, ignoring nodes of other trees.", "    ");
+    header << "    struct NodePusher {" << std::endl;
+    header << "        std::vector<Node*> &stack;" << std::endl;
+    header << "        void operator()(Node &node) {" << std::endl;
+    header << "            stack.push_back(&node);" << std::endl;
+    header << "        }" << std::endl;
+    header << "        template <class T>" << std::endl;
+    header << "        typename std::enable_if<!std::is_base_of<Node, T>::value>::type operator()(T&) {" << std::endl;
+    header << "        }" << std::endl;
+    header << "    };" << std::endl << std::endl;
+    format_doc(header, "Pushes the nodes owned by a field onto the stack.", "    ");
+    header << "    struct FieldPusher {" << std::endl;
+    header << "        std::vector<Node*> &stack;" << std::endl;
+    header << "        template <class T>" << std::endl;
+    header << "        void operator()(const char*, T &field) {" << std::endl;
+    header << "            " << support_ns << "::base::for_each_child(field, NodePusher{stack});" << std::endl;
+    header << "        }" << std::endl;
+    header << "    };" << std::endl << std::endl;
+    format_doc(header, "Pushes the children of a node onto the stack.", "    ");
+    header << "    struct ChildPusher {" << std::endl;
+    header << "        std::vector<Node*> &stack;" << std::endl;
+    header << "        template <class T>" << std::endl;
+    header << "        void operator()(T &node) {" << std::endl;
+    header << "            NodeTraits<T>::for_each_field(node, FieldPusher{stack});" << std::endl;
+    header << "        }" << std::endl;
+    header << "    };" << std::endl << std::endl;
+    header << "};" << std::endl << std::endl;
+
+    // Generate the traversal function.
+    format_doc(
+        header,
+        "Calls f for each node in the tree rooted at the given node, in DFS "
+        "pre-order, with the node statically cast to its leaf type (see "
+        "`dispatch()`). Links and OptLinks are *not* followed. Unlike the "
+        "visitors, this uses an explicit stack rather than recursion, so "
+        "deep trees can't overflow the call stack, and it does not use any "
+        "virtual calls. The tree must not be modified while "
+        "it is being traversed, except for the contents of the node passed "
+        "to f."
+    );
+    header << "template <class F>" << std::endl;
+    header << "void for_each_node(Node &root, F &&f) {" << std::endl;
+    header << "    std::vector<Node*> stack{&root};" << std::endl;
+    header << "    while (!stack.empty()) {" << std::endl;
+    header << "        auto node = stack.back();" << std::endl;
+    header << "        stack.pop_back();" << std::endl;
+    header << "        dispatch(*node, f);" << std::endl;
+    header << "        auto first = stack.size();" << std::endl;
+    header << "        dispatch(*node, NodeWalker::ChildPusher{stack});" << std::endl;
+    header << "        std::reverse(stack.begin() + first, stack.end());" << std::endl;
+    header << "    }" << std::endl;
+    header << "}" << std::endl << std::endl;
+
+}
+
 /**
  * Generate the dumper class.
  */
 void generate_dumper_class(
-    std::ofstream &header,
-    std::ofstream &source,
+    std::ostream &header,
+    std::ostream &source,
     Nodes &nodes,
     std::string &source_location,
+    bool compact_location,
     std::string &support_ns
 ) {
 
@@ -940,6 +1718,11 @@ void generate_dumper_class(
             source << "        out << \" # \" << *loc;" << std::endl;
             source << "    }" << std::endl;
         }
+        if (compact_location) {
+            source << "    if (node.get_location()) {" << std::endl;
+            source << "        out << \" # \" << node.get_location();" << std::endl;
+            source << "    }" << std::endl;
+        }
         source << "    out << std::endl;" << std::endl;
         if (!attributes.empty()) {
             source << "    indent++;" << std::endl;
@@ -1037,7 +1820,7 @@ void generate_dumper_class(
                             source << "    ss.str(\"\");" << std::endl;
                             source << "    ss.clear();" << std::endl;
                         }
-                        source << "    ss << node." << attrib.name << ";" << std::endl;
+                        source << "    ss << node." << get_field_value(attrib) << ";" << std::endl;
                         source << "    pos = ss.str().find_last_not_of(\" \\n\\r\\t\");" << std::endl;
                         source << "    if (pos != std::string::npos) {" << std::endl;
                         source << "        ss.str(ss.str().erase(pos+1));" << std::endl;
@@ -1071,28 +1854,168 @@ void generate_dumper_class(
     header << "};" << std::endl << std::endl;
 }
 
+/**
+ * Returns the filename obtained by inserting a dash and the given suffix
+ * before the extension of the given filename. This names the parts of a split
+ * source file and the headers that a split header consists of.
+ */
+std::string get_derived_filename(const std::string &filename, const std::string &suffix) {
+    auto sep_pos = filename.find_last_of("/\\");
+    auto dot_pos = filename.rfind('.');
+    if (dot_pos == std::string::npos || (sep_pos != std::string::npos && dot_pos < sep_pos)) {
+        dot_pos = filename.size();
+    }
+    return filename.substr(0, dot_pos) + "-" + suffix + filename.substr(dot_pos);
+}
+
+/**
+ * Returns the filename of the header that the class of the given node is
+ * defined in when the output is split, given the filename of the main header.
+ */
+std::string get_node_header_filename(const std::string &header_filename, const Node &node) {
+    return get_derived_filename(header_filename, "node-" + node.snake_case_name);
+}
+
+/**
+ * Returns the 64-bit FNV-1a hash of the given string.
+ */
+uint64_t fnv1a(const std::string &data) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (auto c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/**
+ * Assigns the node classes to the parts of a split source file. The nodes are
+ * sorted by a hash of their name and then dealt out round-robin, such that
+ * all parts get about the same number of classes, and the assignment does not
+ * depend on the order in which the nodes are specified.
+ */
+std::unordered_map<std::string, size_t> assign_node_parts(const Nodes &nodes, size_t parts) {
+    std::vector<std::pair<uint64_t, std::string>> order;
+    for (auto &node : nodes) {
+        order.emplace_back(fnv1a(node->snake_case_name), node->snake_case_name);
+    }
+    std::sort(order.begin(), order.end());
+    std::unordered_map<std::string, size_t> assignment;
+    for (size_t i = 0; i < order.size(); i++) {
+        assignment[order[i].second] = i % parts;
+    }
+    return assignment;
+}
+
+/**
+ * Returns the node types whose classes must be complete before the class of
+ * the given node can be defined: its parent and the types it stores inline.
+ */
+Nodes get_definition_dependencies(const Node &node) {
+    Nodes dependencies;
+    if (node.parent) {
+        dependencies.push_back(node.parent);
+    }
+    for (auto &field : node.fields) {
+        if (field.is_inline) {
+            dependencies.push_back(field.node_type);
+        }
+    }
+    return dependencies;
+}
+
+/**
+ * Adds the node types whose classes must be complete to compile the
+ * implementation of the given node class to the given set: the node itself,
+ * the types of its fields including inherited ones, and the types derived
+ * from it, which it may have to deserialize.
+ */
+void get_implementation_dependencies(const Node &node, std::set<std::string> &dependencies) {
+    dependencies.insert(node.snake_case_name);
+    for (auto &field : node.all_fields()) {
+        if (field.node_type) {
+            dependencies.insert(field.node_type->snake_case_name);
+        }
+    }
+    std::vector<const Node*> stack{&node};
+    while (!stack.empty()) {
+        auto current = stack.back();
+        stack.pop_back();
+        for (auto &derived : current->derived) {
+            auto derived_node = derived.lock();
+            dependencies.insert(derived_node->snake_case_name);
+            stack.push_back(derived_node.get());
+        }
+    }
+}
+
+/**
+ * Generates the class for the given node, preceded by the classes that must be
+ * complete before it can be defined: those of its ancestors and those of the
+ * node types it stores inline. Classes that were already generated are
+ * skipped.
+ */
+void generate_node_class_with_dependencies(
+    std::ostream &header,
+    std::ostream &source,
+    Specification &specification,
+    Node &node,
+    std::unordered_set<std::string> &generated
+) {
+    if (generated.count(node.snake_case_name)) {
+        return;
+    }
+    generated.insert(node.snake_case_name);
+    for (auto &dependency : get_definition_dependencies(node)) {
+        generate_node_class_with_dependencies(header, source, specification, *dependency, generated);
+    }
+    generate_node_class(header, source, specification, node);
+}
+
+/**
+ * Writes a comment with the given digest of the headers included by a split
+ * file. The digest changes whenever one of the headers does, so build systems
+ * that only know about the main header and the source files still rebuild
+ * what depends on a changed node header.
+ */
+void write_header_digest(std::ostream &stream, uint64_t digest) {
+    stream << std::endl;
+    stream << "// Digest of the included node headers: ";
+    stream << std::hex << std::setw(16) << std::setfill('0') << digest;
+    stream << std::dec << std::setfill(' ') << std::endl;
+}
+
 /**
  * Generate the complete C++ code (source and header).
  */
 void generate(
     const std::string &header_filename,
     const std::string &source_filename,
-    Specification &specification
+    Specification &specification,
+    size_t parts
 ) {
     auto nodes = specification.nodes;
 
-    // Open the output files.
-    auto header = std::ofstream(header_filename);
-    if (!header.is_open()) {
-        std::cerr << "Failed to open header file for writing" << std::endl;
-        std::exit(1);
-    }
-    auto source = std::ofstream(source_filename);
-    if (!source.is_open()) {
-        std::cerr << "Failed to open source file for writing" << std::endl;
-        std::exit(1);
+    // Generate into memory first, such that files that didn't change don't
+    // have to be touched.
+    std::ostringstream header;
+    std::ostringstream source;
+    std::vector<std::unique_ptr<std::ostringstream>> part_sources;
+    for (size_t part = 0; part < parts; part++) {
+        part_sources.emplace_back(new std::ostringstream());
     }
 
+    // When the output is split, the node classes are defined in a header per
+    // node. These only depend on a forward declaration header, which
+    // contains everything that only depends on the names of the node types,
+    // and on the headers of the classes they need to be complete. The parts
+    // of the source file only include the headers that they need, so editing
+    // a node type only rebuilds the parts that actually use it. Everything
+    // else, including the main header, is declared in decl_header.
+    std::ostringstream fwd_header;
+    std::ostream &decl_header = parts ? fwd_header : header;
+    std::unordered_map<std::string, std::unique_ptr<std::ostringstream>> node_headers;
+
     // Strip the path from the header filename such that it can be used for the
     // include guard and the #include directive in the source file.
     auto sep_pos = header_filename.rfind('/');
@@ -1101,6 +2024,8 @@ void generate(
         sep_pos = backslash_pos;
     }
     auto header_basename = header_filename.substr(sep_pos + 1);
+    auto header_include = specification.header_fname.empty() ? header_basename : specification.header_fname;
+    auto fwd_basename = get_derived_filename(header_basename, "fwd");
 
     // Generate the include guard name.
     std::string include_guard = header_basename;
@@ -1122,40 +2047,55 @@ void generate(
     }
     header << "#pragma once" << std::endl;
     header << std::endl;
-    header << "#include <iostream>" << std::endl;
+    if (parts) {
+        format_doc(
+            fwd_header,
+            "Forward declarations and node type independent definitions for "
+            + header_basename + ".",
+            "", "\\file");
+        fwd_header << std::endl;
+        fwd_header << "#pragma once" << std::endl;
+        fwd_header << std::endl;
+    }
+    decl_header << "#include <iostream>" << std::endl;
+    decl_header << "#include <unordered_map>" << std::endl;
+    decl_header << "#include <vector>" << std::endl;
+    decl_header << "#include <algorithm>" << std::endl;
+    decl_header << "#include <type_traits>" << std::endl;
     for (auto &include : specification.includes) {
-        header << "#" << include << std::endl;
+        decl_header << "#" << include << std::endl;
     }
-    header << std::endl;
+    decl_header << std::endl;
+    std::ostringstream ns_open;
     for (size_t i = 0; i < specification.namespaces.size(); i++) {
         if (i == specification.namespaces.size() - 1 && !specification.namespace_doc.empty()) {
-            header << std::endl;
-            format_doc(header, specification.namespace_doc);
+            ns_open << std::endl;
+            format_doc(ns_open, specification.namespace_doc);
 
             // Generate dot graph for the tree for the doxygen documentation.
-            header << "/**" << std::endl;
-            header << " * \\dot" << std::endl;
-            header << " * digraph example {" << std::endl;
-            header << " *   node [shape=record, fontname=Helvetica, fontsize=10];" << std::endl;
+            ns_open << "/**" << std::endl;
+            ns_open << " * \\dot" << std::endl;
+            ns_open << " * digraph example {" << std::endl;
+            ns_open << " *   node [shape=record, fontname=Helvetica, fontsize=10];" << std::endl;
             std::ostringstream ns;
             for (auto &name : specification.namespaces) {
                 ns << name << "::";
             }
             for (auto &node : nodes) {
-                header << " *   " << node->title_case_name;
-                header << " [ label=\"" << node->title_case_name;
-                header << "\" URL=\"\\ref " << ns.str() << node->title_case_name;
-                header << "\"";
+                ns_open << " *   " << node->title_case_name;
+                ns_open << " [ label=\"" << node->title_case_name;
+                ns_open << "\" URL=\"\\ref " << ns.str() << node->title_case_name;
+                ns_open << "\"";
                 if (!node->derived.empty()) {
-                    header << ", style=dotted";
+                    ns_open << ", style=dotted";
                 }
-                header << "];" << std::endl;
+                ns_open << "];" << std::endl;
             }
             for (auto &node : nodes) {
                 if (node->parent) {
-                    header << " *   " << node->parent->title_case_name;
-                    header << " -> " << node->title_case_name;
-                    header << " [ arrowhead=open, style=dotted ];" << std::endl;
+                    ns_open << " *   " << node->parent->title_case_name;
+                    ns_open << " -> " << node->title_case_name;
+                    ns_open << " [ arrowhead=open, style=dotted ];" << std::endl;
                 }
             }
             int prim_id = 0;
@@ -1163,8 +2103,8 @@ void generate(
                 for (auto field : node->fields) {
                     EdgeType typ;
                     if (field.node_type) {
-                        header << " *   " << node->title_case_name;
-                        header << " -> " << field.node_type->title_case_name;
+                        ns_open << " *   " << node->title_case_name;
+                        ns_open << " -> " << field.node_type->title_case_name;
                         typ = field.type;
                     } else {
                         std::string full_name = field.prim_type;
@@ -1184,52 +2124,57 @@ void generate(
                                 brief_name = brief_name.substr(pos + 2);
                             }
                         }
-                        header << " *   prim" << prim_id;
-                        header << " [ label=\"" << brief_name;
-                        header << "\" URL=\"\\ref " << full_name;
-                        header << "\"];" << std::endl;
-                        header << " *   " << node->title_case_name;
-                        header << " -> prim" << prim_id;
+                        ns_open << " *   prim" << prim_id;
+                        ns_open << " [ label=\"" << brief_name;
+                        ns_open << "\" URL=\"\\ref " << full_name;
+                        ns_open << "\"];" << std::endl;
+                        ns_open << " *   " << node->title_case_name;
+                        ns_open << " -> prim" << prim_id;
                         typ = field.ext_type;
                         prim_id++;
                     }
-                    header << " [ label=\"" << field.name;
+                    ns_open << " [ label=\"" << field.name;
                     switch (typ) {
-                        case Any: header << "*\", arrowhead=open, style=bold, "; break;
-                        case OptLink: header << "@?\", arrowhead=open, style=dashed, "; break;
-                        case Maybe: header << "?\", arrowhead=open, style=solid, "; break;
-                        case Many: header << "+\", arrowhead=normal, style=bold, "; break;
-                        case Link: header << "@\", arrowhead=normal, style=dashed, "; break;
-                        default: header << "\", arrowhead=normal, style=solid, "; break;
+                        case Any: ns_open << "*\", arrowhead=open, style=bold, "; break;
+                        case OptLink: ns_open << "@?\", arrowhead=open, style=dashed, "; break;
+                        case Maybe: ns_open << "?\", arrowhead=open, style=solid, "; break;
+                        case Many: ns_open << "+\", arrowhead=normal, style=bold, "; break;
+                        case Link: ns_open << "@\", arrowhead=normal, style=dashed, "; break;
+                        default: ns_open << "\", arrowhead=normal, style=solid, "; break;
                     }
-                    header << "fontname=Helvetica, fontsize=10];" << std::endl;
+                    ns_open << "fontname=Helvetica, fontsize=10];" << std::endl;
                 }
             }
-            header << " * }" << std::endl;
-            header << " * \\enddot" << std::endl;
-            header << " */" << std::endl;
-
+            ns_open << " * }" << std::endl;
+            ns_open << " * \\enddot" << std::endl;
+            ns_open << " */" << std::endl;
+        }
+        ns_open << "namespace " << specification.namespaces[i] << " {" << std::endl;
+        if (parts) {
+            fwd_header << "namespace " << specification.namespaces[i] << " {" << std::endl;
         }
-        header << "namespace " << specification.namespaces[i] << " {" << std::endl;
     }
-    header << std::endl;
+    if (!parts) {
+        header << ns_open.str();
+    }
+    decl_header << std::endl;
 
     // Determine the namespace that the base and edge classes are defined in.
     // If it's not the current namespace, pull the types into it using typedefs.
     if (!specification.tree_namespace.empty()) {
         auto tree_namespace = specification.tree_namespace + "::";
-        header << "// Base classes used to construct the tree." << std::endl;
-        header << "using Base = " << tree_namespace << "Base;" << std::endl;
-        header << "template <class T> using Maybe   = " << tree_namespace << "Maybe<T>;" << std::endl;
-        header << "template <class T> using One     = " << tree_namespace << "One<T>;" << std::endl;
-        header << "template <class T> using Any     = " << tree_namespace << "Any<T>;" << std::endl;
-        header << "template <class T> using Many    = " << tree_namespace << "Many<T>;" << std::endl;
-        header << "template <class T> using OptLink = " << tree_namespace << "OptLink<T>;" << std::endl;
-        header << "template <class T> using Link    = " << tree_namespace << "Link<T>;" << std::endl;
-        header << std::endl;
+        decl_header << "// Base classes used to construct the tree." << std::endl;
+        decl_header << "using Base = " << tree_namespace << "Base;" << std::endl;
+        decl_header << "template <class T> using Maybe   = " << tree_namespace << "Maybe<T>;" << std::endl;
+        decl_header << "template <class T> using One     = " << tree_namespace << "One<T>;" << std::endl;
+        decl_header << "template <class T> using Any     = " << tree_namespace << "Any<T>;" << std::endl;
+        decl_header << "template <class T> using Many    = " << tree_namespace << "Many<T>;" << std::endl;
+        decl_header << "template <class T> using OptLink = " << tree_namespace << "OptLink<T>;" << std::endl;
+        decl_header << "template <class T> using Link    = " << tree_namespace << "Link<T>;" << std::endl;
+        decl_header << std::endl;
     }
 
-    // Header for the source file.
+    // Header for the main source file.
     if (!specification.source_doc.empty()) {
         format_doc(source, specification.source_doc, "", "\\file");
         source << std::endl;
@@ -1237,11 +2182,7 @@ void generate(
     for (auto &include : specification.src_includes) {
         source << "#" << include << std::endl;
     }
-    if (!specification.header_fname.empty()) {
-        source << "#include \"" << specification.header_fname << "\"" << std::endl;
-    } else {
-        source << "#include \"" << header_basename << "\"" << std::endl;
-    }
+    source << "#include \"" << header_include << "\"" << std::endl;
     source << std::endl;
     for (auto &name : specification.namespaces) {
         source << "namespace " << name << " {" << std::endl;
@@ -1249,70 +2190,95 @@ void generate(
     source << std::endl;
 
     // Generate forward references for all the classes.
-    header << "// Forward declarations for all classes." << std::endl;
-    header << "class Node;" << std::endl;
+    decl_header << "// Forward declarations for all classes." << std::endl;
+    decl_header << "class Node;" << std::endl;
     for (auto &node : nodes) {
-        header << "class " << node->title_case_name << ";" << std::endl;
+        decl_header << "class " << node->title_case_name << ";" << std::endl;
     }
-    header << "class VisitorBase;" << std::endl;
-    header << "template <typename T = void>" << std::endl;
-    header << "class Visitor;" << std::endl;
-    header << "class RecursiveVisitor;" << std::endl;
-    header << "class Dumper;" << std::endl;
-    header << std::endl;
+    decl_header << "class VisitorBase;" << std::endl;
+    decl_header << "template <typename T = void>" << std::endl;
+    decl_header << "class Visitor;" << std::endl;
+    decl_header << "class RecursiveVisitor;" << std::endl;
+    decl_header << "class FusedVisitor;" << std::endl;
+    decl_header << "template <typename R>" << std::endl;
+    decl_header << "class MemoVisitor;" << std::endl;
+    decl_header << "class Dumper;" << std::endl;
+    decl_header << std::endl;
 
     // Generate the NodeType enum.
-    generate_enum(header, nodes);
+    generate_enum(decl_header, nodes);
 
     // Generate the base class.
     generate_base_class(
-        header,
+        decl_header,
         source,
         nodes,
         !specification.serialize_fn.empty(),
+        specification.compact_location,
         specification.support_namespace
     );
 
-    // Generate the node classes.
-    std::unordered_set<std::string> generated;
-    for (auto node : nodes) {
-        if (generated.count(node->snake_case_name)) {
-            continue;
-        }
-        auto ancestors = Nodes();
-        while (node) {
-            ancestors.push_back(node);
-            node = node->parent;
+    // Generate the node classes. When splitting, the implementations of the
+    // node classes need VisitorBase, so it goes in the forward declaration
+    // header as well.
+    if (!parts) {
+        std::unordered_set<std::string> generated;
+        for (auto &node : nodes) {
+            generate_node_class_with_dependencies(header, source, specification, *node, generated);
         }
-        for (auto node_it = ancestors.rbegin(); node_it != ancestors.rend(); node_it++) {
-            node = *node_it;
-            if (generated.count(node->snake_case_name)) {
-                continue;
+    } else {
+        generate_visitor_base_class(fwd_header, source, nodes);
+        auto assignment = assign_node_parts(nodes, parts);
+        for (auto &node : nodes) {
+            auto &node_header = node_headers[node->snake_case_name];
+            node_header.reset(new std::ostringstream());
+            format_doc(
+                *node_header,
+                "Definition of the `" + node->title_case_name
+                + "` node class for " + header_basename + ".",
+                "", "\\file");
+            *node_header << std::endl;
+            *node_header << "#pragma once" << std::endl;
+            *node_header << std::endl;
+            *node_header << "#include \"" << fwd_basename << "\"" << std::endl;
+            for (auto &dependency : get_definition_dependencies(*node)) {
+                *node_header << "#include \"" << get_node_header_filename(header_basename, *dependency) << "\"" << std::endl;
             }
-            generated.insert(node->snake_case_name);
-            generate_node_class(header, source, specification, *node);
+            *node_header << std::endl;
+            for (auto &name : specification.namespaces) {
+                *node_header << "namespace " << name << " {" << std::endl;
+            }
+            *node_header << std::endl;
+            generate_node_class(*node_header, *part_sources[assignment.at(node->snake_case_name)], specification, *node);
         }
     }
 
     // Generate the visitor classes.
-    generate_visitor_base_class(header, source, nodes);
-    generate_visitor_class(header, source, nodes);
-    generate_recursive_visitor_class(header, source, nodes);
-    generate_dumper_class(header, source, nodes, specification.source_location, specification.support_namespace);
+    if (!parts) {
+        generate_visitor_base_class(header, source, nodes);
+    }
+    std::ostringstream rest;
+    std::ostream &main_header = parts ? static_cast<std::ostream&>(rest) : header;
+    generate_visitor_class(main_header, source, nodes);
+    generate_recursive_visitor_class(main_header, source, nodes);
+    generate_fused_visitor_class(main_header, source, specification.support_namespace);
+    generate_memo_visitor_class(main_header, nodes);
+    generate_dumper_class(main_header, source, nodes, specification.source_location, specification.compact_location, specification.support_namespace);
+    generate_reflection(main_header, nodes, specification.support_namespace);
 
     // Generate the templated visit method and its specialization for void
     // return type.
-    format_doc(header, "Visit this object.");
-    header << "template <typename T>" << std::endl;
-    header << "T Node::visit(Visitor<T> &visitor) {" << std::endl;
-    header << "    T retval;" << std::endl;
-    header << "    this->visit_internal(visitor, &retval);" << std::endl;
-    header << "    return retval;" << std::endl;
-    header << "}" << std::endl << std::endl;
-
-    format_doc(header, "Visit this object.");
-    header << "template <>" << std::endl;
-    header << "void Node::visit(Visitor<void> &visitor);" << std::endl << std::endl;
+    format_doc(main_header, "Visit this object.");
+    main_header << "template <typename T>" << std::endl;
+    main_header << "T Node::visit(Visitor<T> &visitor) {" << std::endl;
+    main_header << "    T retval;" << std::endl;
+    main_header << "    this->visit_internal(visitor, &retval);" << std::endl;
+    main_header << "    return retval;" << std::endl;
+    main_header << "}" << std::endl << std::endl;
+
+    format_doc(main_header, "Visit this object.");
+    main_header << "template <>" << std::endl;
+    main_header << "void Node::visit(Visitor<void> &visitor);" << std::endl << std::endl;
 
     format_doc(source, "Visit this object.");
     source << "template <>" << std::endl;
@@ -1321,8 +2287,8 @@ void generate(
     source << "}" << std::endl << std::endl;
 
     // Overload the stream write operator.
-    format_doc(header, "Stream << overload for tree nodes (writes debug dump).");
-    header << "std::ostream &operator<<(std::ostream &os, const Node &object);" << std::endl << std::endl;
+    format_doc(main_header, "Stream << overload for tree nodes (writes debug dump).");
+    main_header << "std::ostream &operator<<(std::ostream &os, const Node &object);" << std::endl << std::endl;
     format_doc(source, "Stream << overload for tree nodes (writes debug dump).");
     source << "std::ostream &operator<<(std::ostream &os, const Node &object) {" << std::endl;
     source << "    const_cast<Node&>(object).dump(os);" << std::endl;
@@ -1330,12 +2296,110 @@ void generate(
     source << "}" << std::endl << std::endl;
 
     // Close the namespaces.
+    std::ostringstream ns_close;
     for (auto name_it = specification.namespaces.rbegin(); name_it != specification.namespaces.rend(); name_it++) {
-        header << "} // namespace " << *name_it << std::endl;
-        source << "} // namespace " << *name_it << std::endl;
+        ns_close << "} // namespace " << *name_it << std::endl;
     }
-    header << std::endl;
-    source << std::endl;
+    ns_close << std::endl;
+    main_header << ns_close.str();
+    source << ns_close.str();
+
+    // When splitting, assemble the main header and the parts, now that it's
+    // known which node headers they need, and write the node headers.
+    if (parts) {
+        fwd_header << ns_close.str();
+        uint64_t fwd_digest = fnv1a(fwd_header.str());
+        std::unordered_map<std::string, uint64_t> node_digests;
+        for (auto &node : nodes) {
+            auto &node_header = *node_headers.at(node->snake_case_name);
+            node_header << ns_close.str();
+            node_digests[node->snake_case_name] = fnv1a(node_header.str());
+        }
+
+        // Returns the digest of the forward declaration header and the
+        // headers of the given nodes and their definition dependencies.
+        auto get_digest = [&](const std::set<std::string> &names) {
+            std::set<std::string> closure;
+            std::vector<std::string> stack(names.begin(), names.end());
+            while (!stack.empty()) {
+                auto name = stack.back();
+                stack.pop_back();
+                if (!closure.insert(name).second) {
+                    continue;
+                }
+                for (auto &node : nodes) {
+                    if (node->snake_case_name == name) {
+                        for (auto &dependency : get_definition_dependencies(*node)) {
+                            stack.push_back(dependency->snake_case_name);
+                        }
+                    }
+                }
+            }
+            uint64_t digest = fwd_digest;
+            for (auto &name : closure) {
+                digest = (digest ^ node_digests.at(name)) * 0x100000001B3ull;
+            }
+            return digest;
+        };
+
+        // Assemble the main header.
+        std::set<std::string> all_names;
+        header << "#include \"" << fwd_basename << "\"" << std::endl;
+        for (auto &node : nodes) {
+            all_names.insert(node->snake_case_name);
+            header << "#include \"" << get_node_header_filename(header_basename, *node) << "\"" << std::endl;
+        }
+        write_header_digest(header, get_digest(all_names));
+        header << ns_open.str() << std::endl;
+        header << rest.str();
+
+        // Assemble the parts.
+        auto assignment = assign_node_parts(nodes, parts);
+        for (size_t part = 0; part < parts; part++) {
+            std::set<std::string> dependencies;
+            for (auto &node : nodes) {
+                if (assignment.at(node->snake_case_name) == part) {
+                    get_implementation_dependencies(*node, dependencies);
+                }
+            }
+            std::ostringstream stream;
+            format_doc(
+                stream,
+                "Part " + std::to_string(part + 1) + " of " + std::to_string(parts)
+                + " of the node class implementations for " + header_basename + ".",
+                "", "\\file");
+            stream << std::endl;
+            for (auto &include : specification.src_includes) {
+                stream << "#" << include << std::endl;
+            }
+            stream << "#include \"" << get_derived_filename(header_include, "fwd") << "\"" << std::endl;
+            for (auto &node : nodes) {
+                if (dependencies.count(node->snake_case_name)) {
+                    stream << "#include \"" << get_node_header_filename(header_include, *node) << "\"" << std::endl;
+                }
+            }
+            write_header_digest(stream, get_digest(dependencies));
+            stream << std::endl;
+            for (auto &name : specification.namespaces) {
+                stream << "namespace " << name << " {" << std::endl;
+            }
+            stream << std::endl;
+            stream << part_sources[part]->str();
+            stream << ns_close.str();
+            write_if_changed(get_derived_filename(source_filename, std::to_string(part)), stream.str());
+        }
+
+        write_if_changed(get_derived_filename(header_filename, "fwd"), fwd_header.str());
+        for (auto &node : nodes) {
+            write_if_changed(
+                get_node_header_filename(header_filename, *node),
+                node_headers.at(node->snake_case_name)->str());
+        }
+    }
+
+    // Write the main files if they changed.
+    write_if_changed(header_filename, header.str());
+    write_if_changed(source_filename, source.str());
 
 }
 
@@ -15,12 +15,30 @@ namespace tree_gen {
 namespace cpp {
 
 /**
- * Generate the complete C++ code (source and header).
+ * Formats a C++ docstring.
+ */
+void format_doc(
+    std::ostream &stream,
+    const std::string &doc,
+    const std::string &indent = "",
+    const std::string &annotation = ""
+);
+
+/**
+ * Generate the complete C++ code (source and header). If parts is nonzero,
+ * the implementations of the node classes are not written to the main source
+ * file, but are distributed over the given number of additional source files,
+ * named by inserting a dash and the part number (starting from zero) before
+ * the extension of the main source filename. These can then be compiled in
+ * parallel. The node classes are then defined in separate headers as well,
+ * next to a forward declaration header, such that the parts only depend on
+ * the node classes they use.
  */
 void generate(
     const std::string &header_filename,
     const std::string &source_filename,
-    Specification &specification
+    Specification &specification,
+    size_t parts = 0
 );
 
 } // namespace cpp
@@ -3,6 +3,7 @@
  */
 
 #include <fstream>
+#include <sstream>
 #include <iostream>
 #include <unordered_set>
 #include "tree-gen-python.hpp"
@@ -14,7 +15,7 @@ namespace python {
  * Formats a Python docstring.
  */
 void format_doc(
-    std::ofstream &stream,
+    std::ostream &stream,
     const std::string &doc,
     const std::string &indent = ""
 ) {
@@ -63,28 +64,53 @@ void format_doc(
 }
 
 /**
- * Recursive function to print a muxing if statement for all node classes
- * derived from the given node class.
+ * Generates the registration of the field table of the given node class,
+ * which the traversal methods of the Python Node class dispatch on. See
+ * _register().
  */
-void generate_deserialize_mux(
-    std::ofstream &output,
+void generate_field_table(
+    std::ostream &output,
     Node &node
 ) {
-    if (node.derived.empty()) {
-        output << "        if typ == '" << node.title_case_name << "':" << std::endl;
-        output << "            return " << node.title_case_name << "._deserialize(cbor, seq_to_ob, links)" << std::endl;
-    } else {
-        for (auto &derived : node.derived) {
-            generate_deserialize_mux(output, *(derived.lock()));
+    auto all_fields = node.all_fields();
+    output << "_register(" << node.title_case_name << ", (";
+    if (!all_fields.empty()) {
+        output << std::endl;
+        for (const auto &field : all_fields) {
+            EdgeType type = (field.type == Prim) ? field.ext_type : field.type;
+            output << "    ('" << field.name << "', ";
+            switch (type) {
+                case Maybe:   output << "'?'"; break;
+                case One:     output << "'1'"; break;
+                case Any:     output << "'*'"; break;
+                case Many:    output << "'+'"; break;
+                case OptLink: output << "'@'"; break;
+                case Link:    output << "'$'"; break;
+                case Prim:    output << "None"; break;
+            }
+            if (field.type == Prim) {
+                output << ", " << field.py_prim_type;
+            } else {
+                output << ", " << field.node_type->title_case_name;
+            }
+            if (type != Any && type != Many) {
+                output << ", None";
+            } else if (field.type == Prim) {
+                output << ", " << field.py_multi_type;
+            } else {
+                output << ", Multi" << field.node_type->title_case_name;
+            }
+            output << ")," << std::endl;
         }
     }
+    output << "))" << std::endl;
 }
 
 /**
  * Generates the class for the given node.
  */
 void generate_node_class(
-    std::ofstream &output,
+    std::ostream &output,
     Specification &spec,
     Node &node
 ) {
@@ -210,201 +236,6 @@ void generate_node_class(
 
     }
 
-    // Print equality function.
-    if (node.derived.empty()) {
-        output << "    def __eq__(self, other):" << std::endl;
-        format_doc(output, "Equality operator. Ignores annotations!", "        ");
-        output << "        if not isinstance(other, " << node.title_case_name << "):" << std::endl;
-        output << "            return False" << std::endl;
-        for (const auto &field : all_fields) {
-            EdgeType type = (field.type == Prim) ? field.ext_type : field.type;
-            switch (type) {
-                case Maybe:
-                case One:
-                case Any:
-                case Many:
-                case Prim:
-                    output << "        if self." << field.name << " != other." << field.name << ":" << std::endl;
-                    break;
-                case Link:
-                case OptLink:
-                    output << "        if self." << field.name << " is not other." << field.name << ":" << std::endl;
-                    break;
-            }
-            output << "            return False" << std::endl;
-        }
-        output << "        return True" << std::endl << std::endl;
-    }
-
-    // Print dump function.
-    if (node.derived.empty()) {
-        output << "    def dump(self, indent=0, annotations=None, links=1):" << std::endl;
-        format_doc(output,
-                   "Returns a debug representation of this tree as a "
-                   "multiline string. indent is the number of double spaces "
-                   "prefixed before every line. annotations, if specified, "
-                   "must be a set-like object containing the key strings of "
-                   "the annotations that are to be printed. links specifies "
-                   "the maximum link recursion depth.", "        ");
-        output << "        s = ['  '*indent]" << std::endl;
-        output << "        s.append('" << node.title_case_name << "(')" << std::endl;
-        output << "        if annotations is None:" << std::endl;
-        output << "            annotations = []" << std::endl;
-        output << "        for key in annotations:" << std::endl;
-        output << "            if key in self:" << std::endl;
-        output << "                s.append(' # {}: {}'.format(key, self[key]))" << std::endl;
-        output << "        s.append('\\n')" << std::endl;
-        if (!all_fields.empty()) {
-            output << "        indent += 1" << std::endl;
-            for (auto &field : all_fields) {
-                EdgeType type = (field.type == Prim) ? field.ext_type : field.type;
-                output << "        s.append('  '*indent)" << std::endl;
-                output << "        s.append('" << field.name;
-                if (type == Link || type == OptLink) {
-                    output << " --> ";
-                } else {
-                    output << ": ";
-                }
-                output << "')" << std::endl;
-                switch (type) {
-                    case Maybe:
-                    case One:
-                    case OptLink:
-                    case Link:
-                        output << "        if self." << field.name << " is None:" << std::endl;
-                        if (type == One || type == Link) {
-                            output << "            s.append('!MISSING\\n')" << std::endl;
-                        } else {
-                            output << "            s.append('-\\n')" << std::endl;
-                        }
-                        output << "        else:" << std::endl;
-                        output << "            s.append('<\\n')" << std::endl;
-                        if (field.ext_type == Link || field.ext_type == OptLink) {
-                            output << "            if links:" << std::endl;
-                            output << "                s.append(self." << field.name << ".dump(indent + 1, annotations, links - 1) + '\\n')" << std::endl;
-                            output << "            else:" << std::endl;
-                            output << "                s.append('  '*(indent+1) + '...\\n')" << std::endl;
-                        } else {
-                            output << "            s.append(self." << field.name << ".dump(indent + 1, annotations, links) + '\\n')" << std::endl;
-                        }
-                        output << "            s.append('  '*indent + '>\\n')" << std::endl;
-                        break;
-
-                    case Any:
-                    case Many:
-                        output << "        if not self." << field.name << ":" << std::endl;
-                        if (field.ext_type == Many) {
-                            output << "            s.append('!MISSING\\n')" << std::endl;
-                        } else {
-                            output << "            s.append('-\\n')" << std::endl;
-                        }
-                        output << "        else:" << std::endl;
-                        output << "            s.append('[\\n')" << std::endl;
-                        output << "            for child in self." << field.name << ":" << std::endl;
-                        output << "                s.append(child.dump(indent + 1, annotations, links) + '\\n')" << std::endl;
-                        output << "            s.append('  '*indent + ']\\n')" << std::endl;
-                        break;
-
-                    case Prim:
-                        output << "        s.append(str(self." << field.name << ") + '\\n')" << std::endl;
-                        break;
-
-                }
-            }
-            output << "        indent -= 1" << std::endl;
-            output << "        s.append('  '*indent)" << std::endl;
-        }
-        output << "        s.append(')')" << std::endl;
-        output << "        return ''.join(s)" << std::endl << std::endl;
-        output << "    __str__ = dump" << std::endl;
-        output << "    __repr__ = dump" << std::endl << std::endl;
-    }
-
-    // Print find_reachable() function.
-    if (node.derived.empty()) {
-        output << "    def find_reachable(self, id_map=None):" << std::endl;
-        format_doc(output,
-                    "Returns a dictionary mapping Python id() values to "
-                    "stable sequence numbers for all nodes in the tree rooted "
-                    "at this node. If id_map is specified, found nodes are "
-                    "appended to it.", "        ");
-        output << "        if id_map is None:" << std::endl;
-        output << "            id_map = {}" << std::endl;
-        output << "        if id(self) in id_map:" << std::endl;
-        output << "            raise NotWellFormed('node {!r} with id {} occurs more than once'.format(self, id(self)))" << std::endl;
-        output << "        id_map[id(self)] = len(id_map)" << std::endl;
-        for (const auto &field : all_fields) {
-            EdgeType type = (field.type == Prim) ? field.ext_type : field.type;
-            switch (type) {
-                case Maybe:
-                case One:
-                    output << "        if self._attr_" << field.name << " is not None:" << std::endl;
-                    output << "            self._attr_" << field.name << ".find_reachable(id_map)" << std::endl;
-                    break;
-                case Any:
-                case Many:
-                    output << "        for el in self._attr_" << field.name << ":" << std::endl;
-                    output << "            el.find_reachable(id_map)" << std::endl;
-                    break;
-                case Link:
-                case OptLink:
-                case Prim:
-                    break;
-            }
-        }
-        output << "        return id_map" << std::endl << std::endl;
-    }
-
-    // Print check_complete() function.
-    if (node.derived.empty()) {
-        output << "    def check_complete(self, id_map=None):" << std::endl;
-        format_doc(output,
-                   "Raises NotWellFormed if the tree rooted at this node "
-                   "is not well-formed. If id_map is specified, this tree is "
-                   "only a subtree in the context of a larger tree, and id_map "
-                   "must be a dict mapping from Python id() codes to tree "
-                   "indices for all reachable nodes.", "        ");
-        output << "        if id_map is None:" << std::endl;
-        output << "            id_map = self.find_reachable()" << std::endl;
-        for (const auto &field : all_fields) {
-            EdgeType type = (field.type == Prim) ? field.ext_type : field.type;
-            switch (type) {
-                case One:
-                    output << "        if self._attr_" << field.name << " is None:" << std::endl;
-                    output << "            raise NotWellFormed('";
-                    output << field.name << " is required but not set')" << std::endl;
-                    // fallthrough
-                case Maybe:
-                    output << "        if self._attr_" << field.name << " is not None:" << std::endl;
-                    output << "            self._attr_" << field.name << ".check_complete(id_map)" << std::endl;
-                    break;
-                case Many:
-                    output << "        if not self._attr_" << field.name << ":" << std::endl;
-                    output << "            raise NotWellFormed('";
-                    output << field.name << " needs at least one node but has zero')" << std::endl;
-                    // fallthrough
-                case Any:
-                    output << "        for child in self._attr_" << field.name << ":" << std::endl;
-                    output << "            child.check_complete(id_map)" << std::endl;
-                    break;
-                case Link:
-                    output << "        if self._attr_" << field.name << " is None:" << std::endl;
-                    output << "            raise NotWellFormed('";
-                    output << field.name << " is required but not set')" << std::endl;
-                    // fallthrough
-                case OptLink:
-                    output << "        if self._attr_" << field.name << " is not None:" << std::endl;
-                    output << "            if id(self._attr_" << field.name << ") not in id_map:" << std::endl;
-                    output << "                raise NotWellFormed('";
-                    output << field.name << " links to unreachable node')" << std::endl;
-                    break;
-                case Prim:
-                    break;
-            }
-        }
-        output << std::endl;
-    }
-
     // Print copy() function.
     if (node.derived.empty()) {
         output << "    def copy(self):" << std::endl;
@@ -436,258 +267,6 @@ void generate_node_class(
         output << std::endl << "        )" << std::endl << std::endl;
     }
 
-    // Print clone() function.
-    if (node.derived.empty()) {
-        output << "    def clone(self):" << std::endl;
-        format_doc(output,
-                   "Returns a deep copy of this node. This mimics the "
-                   "C++ interface, deficiencies with links included; that is, "
-                   "links always point to the original tree. If you're not "
-                   "cloning a subtree in a context where this is the desired "
-                   "behavior, you may want to use the copy.deepcopy() from the "
-                   "stdlib instead, which should copy links correctly.",
-                   "        ");
-        output << "        return " << node.title_case_name << "(" << std::endl;
-        bool first = true;
-        for (const auto &field : all_fields) {
-            if (first) {
-                first = false;
-            } else {
-                output << "," << std::endl;
-            }
-            output << "            " << field.name << "=";
-            auto type = (field.type != Prim) ? field.type : field.ext_type;
-            switch (type) {
-                case Maybe:
-                case One:
-                case Any:
-                case Many:
-                case Prim:
-                    output << "_cloned(self._attr_" << field.name << ")";
-                    break;
-                case OptLink:
-                case Link:
-                    output << "self._attr_" << field.name;
-                    break;
-            }
-        }
-        output << std::endl << "        )" << std::endl << std::endl;
-    }
-
-    // Print deserialize() function.
-    output << "    @staticmethod" << std::endl;
-    output << "    def _deserialize(cbor, seq_to_ob, links):" << std::endl;
-    format_doc(output,
-               "Attempts to deserialize the given cbor object (in Python "
-               "primitive representation) into a node of this type. All "
-               "(sub)nodes are added to the seq_to_ob dict, indexed by their "
-               "cbor sequence number. All links are registered in the links "
-               "list by means of a two-tuple of the setter function for the "
-               "link field and the sequence number of the target node.",
-               "        ");
-    output << "        if not isinstance(cbor, dict):" << std::endl;
-    output << "            raise TypeError('node description object must be a dict')" << std::endl;
-    output << "        typ = cbor.get('@t', None)" << std::endl;
-    output << "        if typ is None:" << std::endl;
-    output << "            raise ValueError('type (@t) field is missing from node serialization')" << std::endl;
-    if (node.derived.empty()) {
-        output << "        if typ != '" << node.title_case_name << "':" << std::endl;
-        output << "            raise ValueError('found node serialization for ' + typ + ', but expected ";
-        output << node.title_case_name << "')" << std::endl;
-        if (all_fields.empty()) {
-            output << std::endl;
-            output << "        # Construct the " << node.title_case_name << " node." << std::endl;
-            output << "        node = " << node.title_case_name << "()" << std::endl;
-        } else {
-            std::vector<std::string> links;
-            for (const auto &field : all_fields) {
-                output << std::endl;
-                output << "        # Deserialize the " << field.name << " field." << std::endl;
-                output << "        field = cbor.get('" << field.name << "', None)" << std::endl;
-                output << "        if not isinstance(field, dict):" << std::endl;
-                output << "            raise ValueError('missing or invalid serialization of field " << field.name << "')" << std::endl;
-                auto type = (field.type == Prim) ? field.ext_type : field.type;
-                auto type_name = (field.type == Prim) ? field.py_prim_type : field.node_type->title_case_name;
-                auto multi_name = (field.type == Prim) ? field.py_multi_type : ("Multi" + field.node_type->title_case_name);
-                if (type != Prim) {
-                    output << "        if field.get('@T') != '";
-                    switch (type) {
-                        case Maybe:   output << "?"; break;
-                        case One:     output << "1"; break;
-                        case Any:     output << "*"; break;
-                        case Many:    output << "+"; break;
-                        case OptLink: output << "@"; break;
-                        case Link:    output << "$"; break;
-                        case Prim:    throw std::runtime_error("internal error, should be unreachable");
-                    }
-                    output << "':" << std::endl;
-                    output << "            raise ValueError('unexpected edge type for field " << field.name << "')" << std::endl;
-                }
-                switch (type) {
-                    case Maybe:
-                    case One:
-                        output << "        if field.get('@t', None) is None:" << std::endl;
-                        output << "            f_" << field.name << " = None" << std::endl;
-                        output << "        else:" << std::endl;
-                        output << "            f_" << field.name << " = " << type_name << "._deserialize(field, seq_to_ob, links)" << std::endl;
-                        break;
-                    case Any:
-                    case Many:
-                        output << "        data = field.get('@d', None)" << std::endl;
-                        output << "        if not isinstance(data, list):" << std::endl;
-                        output << "            raise ValueError('missing serialization of Any/Many contents')" << std::endl;
-                        output << "        f_" << field.name << " = " << multi_name << "()" << std::endl;
-                        output << "        for element in data:" << std::endl;
-                        output << "            if element.get('@T') != '1':" << std::endl;
-                        output << "                raise ValueError('unexpected edge type for Any/Many element')" << std::endl;
-                        output << "            f_" << field.name << ".append(" << type_name << "._deserialize(element, seq_to_ob, links))" << std::endl;
-                        break;
-                    case Link:
-                    case OptLink:
-                        output << "        f_" << field.name << " = None" << std::endl;
-                        output << "        l_" << field.name << " = field.get('@l', None)" << std::endl;
-                        links.push_back(field.name);
-                        break;
-                    case Prim:
-                        output << "        if hasattr(" << field.py_prim_type << ", 'deserialize_cbor'):" << std::endl;
-                        output << "            f_" << field.name << " = " << field.py_prim_type << ".deserialize_cbor(field)" << std::endl;
-                        output << "        else:" << std::endl;
-                        if (spec.py_deserialize_fn.empty()) {
-                            output << "            raise ValueError('no deserialization function seems to exist for field type " << field.py_prim_type << "')" << std::endl;
-                        } else {
-                            output << "            f_" << field.name << " = " << spec.py_deserialize_fn << "(" << field.py_prim_type << ", field)" << std::endl;
-                        }
-                        break;
-                }
-            }
-            output << std::endl;
-            output << "        # Construct the " << node.title_case_name << " node." << std::endl;
-            output << "        node = " << node.title_case_name << "(";
-            bool first = true;
-            for (const auto &field : all_fields) {
-                if (first) {
-                    first = false;
-                } else {
-                    output << ", ";
-                }
-                output << "f_" << field.name;
-            }
-            output << ")" << std::endl;
-            if (!links.empty()) {
-                output << std::endl;
-                output << "        # Register links to be made after tree construction." << std::endl;
-                for (const auto &link : links) {
-                    output << "        links.append((lambda val: " << node.title_case_name << "." << link << ".fset(node, val), l_" << link << "))" << std::endl;
-                }
-            }
-        }
-        output << std::endl;
-        output << "        # Deserialize annotations." << std::endl;
-        output << "        for key, val in cbor.items():" << std::endl;
-        output << "            if not (key.startswith('{') and key.endswith('}')):" << std::endl;
-        output << "                continue" << std::endl;
-        output << "            key = key[1:-1]" << std::endl;
-        if (spec.py_deserialize_fn.empty()) {
-            output << "            node[key] = val" << std::endl;
-        } else {
-            output << "            node[key] = " << spec.py_deserialize_fn << "(key, val)" << std::endl;
-        }
-        output << std::endl;
-        output << "        # Register node in sequence number lookup." << std::endl;
-        output << "        seq = cbor.get('@i', None)" << std::endl;
-        output << "        if not isinstance(seq, int):" << std::endl;
-        output << "            raise ValueError('sequence number field (@i) is not an integer or missing from node serialization')" << std::endl;
-        output << "        if seq in seq_to_ob:" << std::endl;
-        output << "            raise ValueError('duplicate sequence number %d' % seq)" << std::endl;
-        output << "        seq_to_ob[seq] = node" << std::endl << std::endl;
-        output << "        return node" << std::endl;
-    } else {
-        generate_deserialize_mux(output, node);
-        output << "        raise ValueError('unknown or unexpected type (@t) found in node serialization')" << std::endl;
-    }
-    output << std::endl;
-
-    // Print serialize() function.
-    output << "    def _serialize(self, id_map):" << std::endl;
-    format_doc(output,
-               "Serializes this node to the Python primitive "
-               "representation of its CBOR serialization. The tree that the "
-               "node belongs to must be well-formed. id_map must match Python "
-               "id() calls for all nodes to unique integers, to use for the "
-               "sequence number representation of links.",
-               "        ");
-    output << "        cbor = {'@i': id_map[id(self)], '@t': '" << node.title_case_name << "'}" << std::endl;
-    for (const auto &field : all_fields) {
-        output << std::endl;
-        output << "        # Serialize the " << field.name << " field." << std::endl;
-        auto type = (field.type == Prim) ? field.ext_type : field.type;
-        auto type_name = (field.type == Prim) ? field.py_prim_type : field.node_type->title_case_name;
-        if (type == Prim) {
-            output << "        if hasattr(self._attr_" << field.name << ", 'serialize_cbor'):" << std::endl;
-            output << "            cbor['" << field.name << "'] = self._attr_" << field.name << ".serialize_cbor()" << std::endl;
-            output << "        else:" << std::endl;
-            if (spec.py_serialize_fn.empty()) {
-                output << "            raise ValueError('no serialization function seems to exist for field type " << field.py_prim_type << "')" << std::endl;
-            } else {
-                output << "            cbor['" << field.name << "'] = " << spec.py_serialize_fn << "(" << field.py_prim_type << ", self._attr_" << field.name << ")" << std::endl;
-            }
-        } else {
-            output << "        field = {'@T': '";
-            switch (type) {
-                case Maybe:   output << "?"; break;
-                case One:     output << "1"; break;
-                case Any:     output << "*"; break;
-                case Many:    output << "+"; break;
-                case OptLink: output << "@"; break;
-                case Link:    output << "$"; break;
-                case Prim:    throw std::runtime_error("internal error, should be unreachable");
-            }
-            output << "'}" << std::endl;
-            switch (type) {
-                case Maybe:
-                case One:
-                    output << "        if self._attr_" << field.name << " is None:" << std::endl;
-                    output << "            field['@t'] = None" << std::endl;
-                    output << "        else:" << std::endl;
-                    output << "            field.update(self._attr_" << field.name << "._serialize(id_map))" << std::endl;
-                    break;
-                case Any:
-                case Many:
-                    output << "        lst = []" << std::endl;
-                    output << "        for el in self._attr_" << field.name << ":" << std::endl;
-                    output << "            el = el._serialize(id_map)" << std::endl;
-                    output << "            el['@T'] = '1'" << std::endl;
-                    output << "            lst.append(el)" << std::endl;
-                    output << "        field['@d'] = lst" << std::endl;
-                    break;
-                case Link:
-                case OptLink:
-                    output << "        if self._attr_" << field.name << " is None:" << std::endl;
-                    output << "            field['@l'] = None" << std::endl;
-                    output << "        else:" << std::endl;
-                    output << "            field['@l'] = id_map[id(self._attr_" << field.name << ")]" << std::endl;
-                    break;
-                case Prim:    throw std::runtime_error("internal error, should be unreachable");
-            }
-            output << "        cbor['" << field.name << "'] = field" << std::endl;
-        }
-    }
-    output << std::endl;
-    output << "        # Serialize annotations." << std::endl;
-    output << "        for key, val in self._annot.items():" << std::endl;
-    if (spec.py_serialize_fn.empty()) {
-        output << "            try:" << std::endl;
-        output << "                cbor['{%s}' % key] = _py_to_cbor(val)" << std::endl;
-        output << "            except TypeError:" << std::endl;
-        output << "                pass" << std::endl;
-    } else {
-        output << "            cbor['{%s}' % key] = _py_to_cbor(" << spec.py_serialize_fn << "(key, val))" << std::endl;
-    }
-    output << std::endl;
-    output << "        return cbor" << std::endl << std::endl;
-
-    output << std::endl;
-
     // Print Multi* class.
     output << "class Multi" << node.title_case_name << "(_Multiple):" << std::endl;
     auto doc = "Wrapper for an edge with multiple " + node.title_case_name + " objects.";
@@ -710,12 +289,9 @@ void generate(
 ) {
     auto nodes = specification.nodes;
 
-    // Open the output file.
-    auto output = std::ofstream(python_filename);
-    if (!output.is_open()) {
-        std::cerr << "Failed to open Python file for writing" << std::endl;
-        std::exit(1);
-    }
+    // Generate into memory first, such that the file doesn't have to be
+    // touched if it didn't change.
+    std::ostringstream output;
 
     // Generate header.
     if (!specification.python_doc.empty()) {
@@ -724,6 +300,7 @@ void generate(
     }
     output << "import functools" << std::endl;
     output << "import struct" << std::endl;
+    output << "import sys" << std::endl;
     for (auto &include : specification.python_includes) {
         output << include << std::endl;
     }
@@ -734,6 +311,17 @@ void generate(
 _typemap = {}
 
 
+# Use the optional native CBOR conversion functions if they are available
+# and compatible; otherwise, fall back to the pure-Python implementation
+# below, which behaves the same.
+try:
+    import tree_gen_cbor as _native_cbor
+    if getattr(_native_cbor, 'API_VERSION', None) != 1:
+        _native_cbor = None
+except ImportError:
+    _native_cbor = None
+
+
 def _cbor_read_intlike(cbor, offset, info):
     """Parses the additional information and reads any additional bytes it
     specifies the existence of, and returns the encoded integer. offset
@@ -785,6 +373,8 @@ def _sub_cbor_to_py(cbor, offset):
      - 7.20: false (bool)
      - 7.21: true (bool)
      - 7.22: null (NoneType)
+     - 7.25: half-precision float (float)
+     - 7.26: single-precision float (float)
      - 7.27: double-precision float (float)
 
     Both definite-length and indefinite-length notation is supported for sized
@@ -838,8 +428,12 @@ def _sub_cbor_to_py(cbor, offset):
             value = cbor[offset:offset + size]
             offset += size
 
+        # Note that cbor may be a memoryview, in which case the slices are
+        # views as well.
         if typ == 3:
-            value = value.decode('UTF-8')
+            value = str(value, 'UTF-8')
+        else:
+            value = bytes(value)
         return value, offset
 
     # Handle array (4) and map (5).
@@ -913,11 +507,13 @@ def _sub_cbor_to_py(cbor, offset):
 
     if info == 25:
         # Half-precision float.
-        raise ValueError('invalid CBOR: half-precision float is not supported')
+        value, = struct.unpack('>e', cbor[offset:offset+2])
+        return value, offset + 2
 
     if info == 26:
         # Single-precision float.
-        raise ValueError('invalid CBOR: single-precision float is not supported')
+        value, = struct.unpack('>f', cbor[offset:offset+4])
+        return value, offset + 4
 
     if info == 27:
         # Double-precision float.
@@ -945,18 +541,61 @@ def _cbor_to_py(cbor):
      - 7.20: false (bool)
      - 7.21: true (bool)
      - 7.22: null (NoneType)
+     - 7.25: half-precision float (float)
+     - 7.26: single-precision float (float)
      - 7.27: double-precision float (float)
 
     Both definite-length and indefinite-length notation is supported for sized
     objects (strings, arrays, maps). A ValueError is thrown if the CBOR is
     invalid or contains unsupported structures."""
 
+    if _native_cbor is not None:
+        return _native_cbor.loads(cbor)
     value, length = _sub_cbor_to_py(cbor, 0)
     if length < len(cbor):
         raise ValueError('invalid CBOR: garbage at the end')
     return value
 
 
+def _resolve_strings(value, strings):
+    """Replaces the references to the string table of a serialized tree (maps
+    with only an @r entry, written for interned strings by the C++ code) in
+    the given Python representation of a CBOR object with the strings they
+    refer to. The maps and arrays are copied without recursion, so the depth
+    of the tree is not limited by the Python recursion limit."""
+
+    def convert(val):
+        if isinstance(val, dict):
+            if len(val) == 1 and '@r' in val:
+                index = val['@r']
+                if not isinstance(index, int) or not 0 <= index < len(strings):
+                    raise ValueError('string table index out of range')
+                return strings[index]
+            copy = dict(val)
+        elif isinstance(val, list):
+            copy = list(val)
+        else:
+            return val
+        work.append(copy)
+        return copy
+
+    # The work list contains the copied maps and arrays whose values still
+    # have to be converted.
+    work = []
+    result = convert(value)
+    while work:
+        container = work.pop()
+        if isinstance(container, dict):
+            for key, val in container.items():
+                if isinstance(val, (dict, list)):
+                    container[key] = convert(val)
+        else:
+            for index, val in enumerate(container):
+                if isinstance(val, (dict, list)):
+                    container[index] = convert(val)
+    return result
+
+
 class _Cbor(bytes):
     """Marker class indicating that this bytes object represents CBOR."""
     pass
@@ -999,6 +638,9 @@ def _py_to_cbor(value, type_converter=None):
     if isinstance(value, _Cbor):
         return value
 
+    if _native_cbor is not None:
+        return _Cbor(_native_cbor.dumps(value, _Cbor, type_converter))
+
     if isinstance(value, int):
         return _Cbor(_cbor_write_intlike(value))
 
@@ -1054,6 +696,21 @@ class Node(object):
 
     __slots__ = ['_annot']
 
+    # Map from type name to node class for the tree this class belongs to.
+    _typemap = _typemap
+
+    # Field tables of the node class, set up by _register() for all node
+    # classes that can be instantiated. The traversal methods below dispatch
+    # on these rather than recursing into per-class methods, such that they
+    # work for trees of any depth, including the nodes of other trees that
+    # external edges lead to.
+    _fields = None
+    _flat_fields = None
+    _children = ()
+    _checks = ()
+    _layout = ()
+    _decoders = None
+
     def __init__(self):
         super().__init__()
         self._annot = {}
@@ -1084,25 +741,166 @@ class Node(object):
         """Returns whether an annotation exists for the specified key."""
         return key in self._annot
 
-    @staticmethod
+    def __eq__(self, other):
+        """Equality operator. Ignores annotations!"""
+
+        # The work list contains the pairs of nodes still to be compared.
+        work = [(self, other)]
+        while work:
+            node, other = work.pop()
+            if node is other:
+                continue
+            cls = node.__class__
+            if not isinstance(other, cls) or cls._fields is None:
+                return False
+            for name, attr, edge, typ, multi in cls._fields:
+                val = getattr(node, attr)
+                other_val = getattr(other, attr)
+                if edge is None:
+                    if val != other_val:
+                        return False
+                elif edge in '*+':
+                    if len(val._l) != len(other_val._l):
+                        return False
+                    work.extend(zip(val._l, other_val._l))
+                elif edge in '@$' or val is None or other_val is None:
+                    if val is not other_val:
+                        return False
+                else:
+                    work.append((val, other_val))
+        return True
+
+    def dump(self, indent=0, annotations=None, links=1):
+        """Returns a debug representation of this tree as a multiline string.
+        indent is the number of double spaces prefixed before every line.
+        annotations, if specified, must be a set-like object containing the key
+        strings of the annotations that are to be printed. links specifies the
+        maximum link recursion depth."""
+        if annotations is None:
+            annotations = ()
+        s = []
+
+        # The work list contains the strings still to be written, in reverse
+        # order, with three-tuples of a node, its indentation level and the
+        # remaining link depth in place of the dumps of the subtrees.
+        work = [(self, indent, links)]
+        while work:
+            item = work.pop()
+            if item.__class__ is str:
+                s.append(item)
+                continue
+            node, indent, links = item
+            cls = node.__class__
+            s.append('  '*indent + cls.__name__ + '(')
+            for key in annotations:
+                if key in node:
+                    s.append(' # {}: {}'.format(key, node[key]))
+            s.append('\n')
+            if not cls._fields:
+                s.append(')')
+                continue
+            prefix = '  '*(indent + 1)
+
+            # Lines are written to s directly up to the first child node;
+            # everything after it is deferred through the work list.
+            items = None
+            emit = s.append
+            for name, attr, edge, typ, multi in cls._fields:
+                val = getattr(node, attr)
+                if edge is None:
+                    emit(prefix + name + ': ' + str(val) + '\n')
+                elif edge in '*+':
+                    if not val:
+                        emit(prefix + name + (': !MISSING\n' if edge == '+' else ': -\n'))
+                        continue
+                    emit(prefix + name + ': [\n')
+                    for child in val._l:
+                        flat = child._flat_fields
+                        if flat and not annotations:
+                            emit(_dump_flat(child, flat, indent + 2) + '\n')
+                            continue
+                        if items is None:
+                            items = []
+                            emit = items.append
+                        emit((child, indent + 2, links))
+                        emit('\n')
+                    emit(prefix + ']\n')
+                else:
+                    link = edge in '@$'
+                    head = prefix + name + (' --> ' if link else ': ')
+                    if val is None:
+                        emit(head + ('-\n' if edge in '?@' else '!MISSING\n'))
+                    elif link and not links:
+                        emit(head + '<\n' + prefix + '  ...\n' + prefix + '>\n')
+                    elif val._flat_fields and not annotations:
+                        emit(head + '<\n' + _dump_flat(val, val._flat_fields, indent + 2) + '\n' + prefix + '>\n')
+                    else:
+                        emit(head + '<\n')
+                        if items is None:
+                            items = []
+                            emit = items.append
+                        emit((val, indent + 2, links - 1 if link else links))
+                        emit('\n' + prefix + '>\n')
+            emit('  '*indent + ')')
+            if items is not None:
+                work.extend(reversed(items))
+        return ''.join(s)
+
+    __str__ = dump
+    __repr__ = dump
+
+    def _walk(self):
+        """Yields the nodes of the tree rooted at this node in depth-first
+        pre-order, following all edges except links. The nodes still to be
+        visited are kept on an explicit stack, so this works for trees of any
+        depth."""
+        stack = [self]
+        pop = stack.pop
+        push = stack.append
+        extend = stack.extend
+        while stack:
+            node = pop()
+            yield node
+            for attr, many in node._children:
+                child = getattr(node, attr)
+                if many:
+                    extend(reversed(child._l))
+                elif child is not None:
+                    push(child)
+
     def find_reachable(self, id_map=None):
         """Returns a dictionary mapping Python id() values to stable sequence
         numbers for all nodes in the tree rooted at this node. If id_map is
-        specified, found nodes are appended to it. Note that this is overridden
-        by the actual node class implementations; this base function does very
-        little."""
+        specified, found nodes are appended to it."""
         if id_map is None:
             id_map = {}
+        for node in self._walk():
+            key = id(node)
+            if key in id_map:
+                raise NotWellFormed('node {!r} with id {} occurs more than once'.format(node, key))
+            id_map[key] = len(id_map)
         return id_map
 
     def check_complete(self, id_map=None):
         """Raises NotWellFormed if the tree rooted at this node is not
         well-formed. If id_map is specified, this tree is only a subtree in the
         context of a larger tree, and id_map must be a dict mapping from Python
-        id() codes to tree indices for all reachable nodes. Note that this is
-        overridden by the actual node class implementations; this base function
-        always raises an exception."""
-        raise NotWellFormed('found node of abstract type ' + type(self).__name__)
+        id() codes to tree indices for all reachable nodes."""
+        if id_map is None:
+            id_map = self.find_reachable()
+        for node in self._walk():
+            if node._fields is None:
+                raise NotWellFormed('found node of abstract type ' + type(node).__name__)
+            for name, attr, edge in node._checks:
+                val = getattr(node, attr)
+                if edge == '+':
+                    if not val:
+                        raise NotWellFormed(name + ' needs at least one node but has zero')
+                elif val is None:
+                    if edge != '@':
+                        raise NotWellFormed(name + ' is required but not set')
+                elif edge in '@$' and id(val) not in id_map:
+                    raise NotWellFormed(name + ' links to unreachable node')
 
     def check_well_formed(self):
         """Checks whether the tree starting at this node is well-formed. That
@@ -1141,25 +939,108 @@ class Node(object):
         raise TypeError('can\'t copy node of abstract type ' + type(self).__name__)
 
     def clone(self):
-        """Returns a deep copy of this node. Note that this is overridden by
-        the actual node class implementations; this base function always raises
-        an exception."""
-        raise TypeError('can\'t clone node of abstract type ' + type(self).__name__)
+        """Returns a deep copy of this node. This mimics the C++ interface,
+        deficiencies with links included; that is, links always point to the
+        original tree. If you're not cloning a subtree in a context where this
+        is the desired behavior, you may want to use the copy.deepcopy() from
+        the stdlib instead, which should copy links correctly."""
+        root = []
+
+        # The work list contains three-tuples of the node to be cloned, and
+        # the node and attribute name to assign the clone to, or a list to
+        # append it to and None.
+        work = [(self, root, None)]
+        while work:
+            node, parent, target = work.pop()
+            cls = node.__class__
+            if cls._fields is None:
+                raise TypeError('can\'t clone node of abstract type ' + cls.__name__)
+            clone = cls.__new__(cls)
+            clone._annot = {}
+            for name, attr, edge, typ, multi in cls._fields:
+                val = getattr(node, attr)
+                if edge is None:
+                    setattr(clone, attr, _cloned(val))
+                elif edge in '*+':
+                    children = val.__class__.__new__(val.__class__)
+                    children._l = []
+                    setattr(clone, attr, children)
+                    work.extend([(child, children._l, None) for child in reversed(val._l)])
+                elif edge in '@$' or val is None:
+                    setattr(clone, attr, val)
+                else:
+                    work.append((val, clone, attr))
+            if target is None:
+                parent.append(clone)
+            else:
+                setattr(parent, target, clone)
+        return root[0]
 
     @classmethod
-    def deserialize(cls, cbor):
-        """Attempts to deserialize the given cbor object (either as bytes or as
-        its Python primitive representation) into a node of this type."""
-        if isinstance(cbor, bytes):
-            cbor = _cbor_to_py(cbor)
+    def deserialize(cls, cbor, trusted=False):
+        """Attempts to deserialize the given cbor object (either as a
+        bytes-like object or as its Python primitive representation) into a
+        node of this type. Unless the native CBOR codec is available (which
+        is faster at building the Python representation of the complete
+        object), bytes-like objects are decoded into nodes directly, without
+        building the Python representation first. If trusted is set, the
+        values of primitive fields and links decoded this way are assumed to
+        be of the right type, and are assigned without going through the
+        field setters."""
+        if isinstance(cbor, (bytes, bytearray, memoryview)):
+            data = cbor
+            cbor = None
+            if _native_cbor is not None:
+                try:
+                    cbor = _cbor_to_py(data)
+                except RecursionError:
+                    # The native codec is bounded by the recursion limit,
+                    # but the fused deserializer is not.
+                    pass
+            if cbor is None:
+                try:
+                    return cls._decode(data, trusted)
+                except _Unordered:
+                    cbor = _cbor_to_py(data)
+        if isinstance(cbor, dict) and '@S' in cbor:
+            strings = [sys.intern(string) for string in cbor['@S']]
+            cbor = _resolve_strings(cbor, strings)
         seq_to_ob = {}
         links = []
         root = cls._deserialize(cbor, seq_to_ob, links)
-        for link_setter, seq in links:
-            ob = seq_to_ob.get(seq, None)
-            if ob is None:
-                raise ValueError('found link to nonexistent object')
-            link_setter(ob)
+        _resolve_links(links, seq_to_ob)
+        return root
+
+    @classmethod
+    def _decode(cls, cbor, trusted):
+        """Decodes the given bytes-like object into a node of this type using
+        the fused deserializer. Raises _Unordered if the serialization can't
+        be decoded this way."""
+        data = memoryview(cbor).cast('B')
+
+        # The string table, if any, is usually written after the nodes that
+        # refer to it, in which case the primitive fields and annotations can
+        # only be loaded once the complete tree has been decoded.
+        defer = not isinstance(cbor, (bytes, bytearray)) or cbor.find(b'\x62@S') >= 0
+        ctx = _DecodeContext(defer, trusted)
+        try:
+            root, _, offset = _decode_tree(data, 0, cls, ctx)
+        except IndexError:
+            raise ValueError('invalid CBOR: unexpected end of data')
+        if offset < len(data):
+            raise ValueError('invalid CBOR: garbage at the end')
+        if root is None:
+            raise ValueError('type (@t) field is missing from node serialization')
+        if defer:
+            strings = ctx.strings
+            for node, entry, value in ctx.deferred:
+                if strings is not None:
+                    value = _resolve_strings(value, strings)
+                if entry is None:
+                    node._load_annotation(node, value, ctx)
+                else:
+                    _load_primitive(node, entry, value, ctx)
+        _resolve_links(ctx.links, ctx.seq_to_ob)
         return root
 
     def serialize(self):
@@ -1167,19 +1048,185 @@ class Node(object):
         bytes object."""
         id_map = self.find_reachable()
         self.check_complete(id_map)
-        return _py_to_cbor(self._serialize(id_map))
-
-    @staticmethod
-    def _deserialize(cbor, seq_to_ob, links):
-        if not isinstance(cbor, dict):
-            raise TypeError('node description object must be a dict')
-        typ = cbor.get('@t', None)
-        if typ is None:
-            raise ValueError('type (@t) field is missing from node serialization')
-        node_type = _typemap.get(cbor.get('@t'), None)
-        if node_type is None:
-            raise ValueError('unknown node type (@t): ' + str(cbor.get('@t')))
-        return node_type._deserialize(cbor, seq_to_ob, links)
+        buf = bytearray()
+        # The root is written as the target of a Maybe edge, like C++ does,
+        # such that C++ can deserialize the result.
+        self._serialize(id_map, buf, b'\x62@T\x61?')
+        return _Cbor(buf)
+
+    def _serialize(self, id_map, buf, edge=None):
+        """Serializes this node to CBOR by appending it to the given
+        bytearray. The tree that the node belongs to must be well-formed.
+        id_map must match Python id() calls for all nodes to unique integers,
+        to use for the sequence number representation of links. If edge is
+        specified, it must be the CBOR-encoded key and value of the edge type
+        (@T) entry of the edge leading to this node, which is merged into the
+        map for the node.
+
+        The keys of each map are written in sorted order, such that the result
+        is the same as that of _py_to_cbor() for the equivalent dict. The edge
+        and node keys start with @, which sorts before the field names, which
+        in turn sort before the annotation keys (which are enclosed in curly
+        braces)."""
+
+        def write(node, edge, out):
+            """Writes the given node to out, up to its first child node that
+            owns nodes itself. Children without such edges are written in
+            place. Returns None if the node was written completely, or the
+            list of the remaining work items otherwise."""
+            cls = node.__class__
+            serialize_primitive = cls._serialize_primitive
+            if node._annot:
+                annotations = node._serialize_annotations(node)
+                if edge is None:
+                    out += _cbor_write_intlike(len(cls._layout) + 2 + len(annotations), 5)
+                else:
+                    out += _cbor_write_intlike(len(cls._layout) + 3 + len(annotations), 5)
+            else:
+                annotations = ()
+                out += cls._root_map_head if edge is None else cls._map_head
+            if edge is not None:
+                out += edge
+            out += b'\x62@i'
+            out += _cbor_write_intlike(id_map[id(node)])
+            out += cls._type_key
+
+            # Fields are written to out directly up to the first child node
+            # that owns nodes; everything after it is deferred through the
+            # work list.
+            items = None
+            for attr, edge, typ, head, tail in cls._layout:
+                val = getattr(node, attr)
+                out += head
+                if edge is None:
+                    out += serialize_primitive(typ, val)
+                elif edge in '*+':
+                    out += _cbor_write_intlike(len(val._l), 4)
+                    for child in val._l:
+                        if not child._children:
+                            write(child, tail, out)
+                            continue
+                        if items is None:
+                            items = []
+                        items.append((child, tail))
+                        out = bytearray()
+                        items.append(out)
+                elif edge in '@$':
+                    if val is None:
+                        out += b'\xf6'
+                    else:
+                        out += _cbor_write_intlike(id_map[id(val)])
+                elif val is None:
+                    out += b'\xa2' + tail + b'\x62@t\xf6'
+                elif not val._children:
+                    write(val, tail, out)
+                else:
+                    if items is None:
+                        items = []
+                    items.append((val, tail))
+                    out = bytearray()
+                    items.append(out)
+
+            # Serialize annotations.
+            for key, val in annotations:
+                out += _py_to_cbor(key)
+                out += val
+
+            return items
+
+        # The work list contains the bytes still to be written, in reverse
+        # order, with two-tuples of a node and its edge entry in place of the
+        # serializations of the subtrees.
+        work = [(self, edge)]
+        pop = work.pop
+        while work:
+            item = pop()
+            if item.__class__ is not tuple:
+                buf += item
+                continue
+            items = write(item[0], item[1], buf)
+            if items is not None:
+                work.extend(reversed(items))
+
+    @classmethod
+    def _deserialize(cls, cbor, seq_to_ob, links):
+        """Attempts to deserialize the given cbor object (in Python primitive
+        representation) into a node of this type (or a subclass thereof). All
+        (sub)nodes are added to the seq_to_ob dict, indexed by their cbor
+        sequence number. All links are registered in the links list by means
+        of a three-tuple of the node, the name of the link attribute, and the
+        sequence number of the target node."""
+        root = []
+
+        # The work list contains four-tuples of the serialization of a node,
+        # the type it must have, and the node and attribute name to assign it
+        # to, or a list to append it to and None.
+        work = [(cbor, cls, root, None)]
+        while work:
+            cbor, base, parent, target = work.pop()
+            if not isinstance(cbor, dict):
+                raise TypeError('node description object must be a dict')
+            typ = cbor.get('@t', None)
+            if typ is None:
+                raise ValueError('type (@t) field is missing from node serialization')
+            node_type = base._typemap.get(typ, None) if isinstance(typ, str) else None
+            if node_type is None:
+                raise ValueError('unknown node type (@t): ' + str(typ))
+            if not issubclass(node_type, base) or node_type._fields is None:
+                raise ValueError('unknown or unexpected type (@t) found in node serialization')
+            node = node_type.__new__(node_type)
+            node._annot = {}
+
+            # Deserialize the fields. The setters are used, such that the
+            # values are typechecked.
+            for name, attr, edge, typ, multi in node_type._fields:
+                field = cbor.get(name, None)
+                if not isinstance(field, dict):
+                    raise ValueError('missing or invalid serialization of field ' + name)
+                if edge is None:
+                    setattr(node, name, node._deserialize_primitive(typ, field))
+                    continue
+                if field.get('@T') != edge:
+                    raise ValueError('unexpected edge type for field ' + name)
+                if edge in '*+':
+                    data = field.get('@d', None)
+                    if not isinstance(data, list):
+                        raise ValueError('missing serialization of Any/Many contents')
+                    children = multi()
+                    setattr(node, name, children)
+                    for element in reversed(data):
+                        if not isinstance(element, dict) or element.get('@T') != '1':
+                            raise ValueError('unexpected edge type for Any/Many element')
+                        work.append((element, typ, children._l, None))
+                elif edge in '@$':
+                    setattr(node, name, None)
+                    links.append((node, name, field.get('@l', None)))
+                elif field.get('@t', None) is None:
+                    setattr(node, name, None)
+                else:
+                    work.append((field, typ, node, name))
+
+            # Deserialize annotations.
+            for key, val in cbor.items():
+                if key.startswith('{') and key.endswith('}'):
+                    node._load_annotation(node, [key[1:-1], val], None)
+
+            # Register node in sequence number lookup. Shared instances of
+            # field-less nodes are serialized without a sequence number by the
+            # C++ side.
+            seq = cbor.get('@i', None)
+            if seq is not None or node_type._fields:
+                if not isinstance(seq, int):
+                    raise ValueError('sequence number field (@i) is not an integer or missing from node serialization')
+                if seq in seq_to_ob:
+                    raise ValueError('duplicate sequence number %d' % seq)
+                seq_to_ob[seq] = node
+
+            if target is None:
+                parent.append(node)
+            else:
+                setattr(parent, target, node)
+        return root[0]
 
 )PY" << R"PY(
 @functools.total_ordering
@@ -1316,8 +1363,484 @@ def _cloned(obj):
     return obj
 
 
+def _register(cls, fields):
+    """Sets up the field tables of the given node class, which the traversal
+    methods of Node dispatch on. fields must list a four-tuple for each field
+    of the class, in declaration order: the name of the field, the edge type
+    (@T) of the field or None for primitives, the node or primitive type, and
+    the Multi* class for Any/Many edges."""
+
+    # Five-tuples of the name, attribute name, edge type, type, and Multi*
+    # class of each field, in declaration order.
+    cls._fields = tuple((name, '_attr_' + name, edge, typ, multi) for name, edge, typ, multi in fields)
+
+    # Two-tuples of the label and attribute name of each field, if all the
+    # fields of the class are primitives, such that dump() can write nodes of
+    # the class in one go. None if the class has edges or no fields at all.
+    cls._flat_fields = None
+    if cls._fields and all(edge is None for _, _, edge, _, _ in cls._fields):
+        cls._flat_fields = tuple((name + ': ', attr) for name, attr, _, _, _ in cls._fields)
+
+    # Two-tuples of the attribute name and whether it's an Any/Many edge for
+    # each field that owns nodes, in reverse order, as used by _walk().
+    cls._children = tuple(
+        (attr, edge in '*+')
+        for _, attr, edge, _, _ in reversed(cls._fields)
+        if edge is not None and edge in '?1*+')
+
+    # Three-tuples of the name, attribute name, and edge type of each field
+    # that check_complete() needs to check.
+    cls._checks = tuple(
+        (name, attr, edge)
+        for name, attr, edge, _, _ in cls._fields
+        if edge is not None and edge in '1+@$')
+
+    # Five-tuples of the attribute name, the edge type, the type, the CBOR
+    # bytes that precede the value, and the edge entry of the child nodes
+    # for each field, in the order in which _serialize() writes them.
+    layout = []
+    for name, attr, edge, typ, multi in sorted(cls._fields):
+        head = _py_to_cbor(name)
+        tail = None
+        if edge is not None:
+            tail = b'\x62@T\x61' + edge.encode()
+            if edge in '*+':
+                head += b'\xa2' + tail + b'\x62@d'
+                tail = b'\x62@T\x611'
+            elif edge in '@$':
+                head += b'\xa2' + tail + b'\x62@l'
+        layout.append((attr, edge, typ, head, tail))
+    cls._layout = tuple(layout)
+    cls._type_key = _py_to_cbor('@t') + _py_to_cbor(cls.__name__)
+
+    # The CBOR map headers of nodes without annotations, when written as the
+    # target of an edge, and as the root without one.
+    cls._map_head = _cbor_write_intlike(len(layout) + 3, 5)
+    cls._root_map_head = _cbor_write_intlike(len(layout) + 2, 5)
+
+    # Map from field name to a six-tuple of a bit identifying the field, the
+    # name, attribute name, edge type, type, and Multi* class of the field,
+    # used by _decode_tree().
+    cls._decoders = {
+        field[0]: (1 << index,) + field
+        for index, field in enumerate(cls._fields)}
+    cls._decoders_mask = (1 << len(fields)) - 1
+
+
+def _dump_flat(node, fields, indent):
+    """Returns the dump of a node without annotations whose fields are all
+    primitives, given the _flat_fields of its class."""
+    prefix = '  '*indent
+    s = [prefix, node.__class__.__name__, '(\n']
+    for label, attr in fields:
+        s.append(prefix + '  ' + label + str(getattr(node, attr)) + '\n')
+    s.append(prefix + ')')
+    return ''.join(s)
+
+
+def _resolve_links(links, seq_to_ob):
+    """Assigns the links registered while deserializing a tree, given as
+    three-tuples of a node, the name of the link attribute, and the sequence
+    number of the target node."""
+    for node, attr, seq in links:
+        ob = seq_to_ob.get(seq, None)
+        if ob is None:
+            raise ValueError('found link to nonexistent object')
+        setattr(node, attr, ob)
+
+
+class _Unordered(Exception):
+    """Raised by the fused deserializer when a node serialization lists a
+    field before the node type (@t), or when it finds a string table it
+    didn't expect. Node.deserialize() then falls back to deserialization via
+    the Python representation of the CBOR object."""
+    pass
+
+
+class _DecodeContext(object):
+    """State of the fused deserializer. seq_to_ob maps sequence numbers to the
+    nodes decoded so far, links lists the links to be made like the links
+    list of Node._deserialize(), deferred is None or a list of three-tuples of
+    a node, the decoder entry of a primitive field (or None for an
+    annotation), and the Python representation of the primitive or annotation
+    to be loaded into it once the string table is known, strings is the
+    string table if one was found, and trusted specifies whether the setters
+    of the node classes may be bypassed."""
+
+    __slots__ = ['seq_to_ob', 'links', 'deferred', 'strings', 'trusted']
+
+    def __init__(self, defer, trusted):
+        super().__init__()
+        self.seq_to_ob = {}
+        self.links = []
+        self.deferred = [] if defer else None
+        self.strings = None
+        self.trusted = trusted
+
+
+def _decode_header(data, offset, major, error):
+    """Reads the header of the array (major 4) or map (major 5) at the given
+    offset of the given memoryview, skipping any semantic tags. Returns the
+    number of items, or None for an indefinite-length structure, and the
+    offset of the first item. Raises a ValueError with the given message if
+    the object is of a different type."""
+    initial = data[offset]
+    while initial >> 5 == 6:
+        _, offset = _cbor_read_intlike(data, offset + 1, initial & 0x1F)
+        initial = data[offset]
+    if initial >> 5 != major:
+        raise ValueError(error)
+    info = initial & 0x1F
+    if info == 31:
+        return None, offset + 1
+    return _cbor_read_intlike(data, offset + 1, info)
+
+
+def _decode_key(data, offset):
+    """Reads the map key at the given offset of the given memoryview, and
+    returns it along with the offset of the value."""
+    initial = data[offset]
+    if 0x60 <= initial < 0x78:
+        end = offset + 1 + (initial - 0x60)
+        if end > len(data):
+            raise ValueError('invalid CBOR: unexpected end of data')
+        return str(data[offset + 1:end], 'UTF-8'), end
+    key, offset = _sub_cbor_to_py(data, offset)
+    if not isinstance(key, str):
+        raise ValueError('invalid CBOR: map key is not a UTF-8 string')
+    return key, offset
+
+
+def _decode_value(data, offset):
+    """Same as _sub_cbor_to_py(), but faster for the small integers and short
+    strings used for sequence numbers and type names."""
+    initial = data[offset]
+    if initial < 0x1C:
+        return _cbor_read_intlike(data, offset + 1, initial)
+    if 0x60 <= initial < 0x78:
+        end = offset + 1 + (initial - 0x60)
+        if end > len(data):
+            raise ValueError('invalid CBOR: unexpected end of data')
+        return str(data[offset + 1:end], 'UTF-8'), end
+    return _sub_cbor_to_py(data, offset)
+
+
+def _decode_tree(data, offset, base, ctx):
+    """Decodes the map at the given offset of the given memoryview, which must
+    be the serialization of a node of type base (or a subclass thereof) or of
+    an empty edge, along with the edge type (@T) entry of the edge leading to
+    it, if any. Returns the node (or None for an empty edge), the edge type,
+    and the offset following the map. Rather than recursing into the maps of
+    the child nodes, the decoding state of their parents is pushed onto an
+    explicit stack, so trees of any depth can be decoded."""
+    stack = []
+    seq_to_ob = ctx.seq_to_ob
+
+    # Decoding state of the map of the current node.
+    count, offset = _decode_header(data, offset, 5, 'node description object must be a dict')
+    typ = cls = node = decoders = edge = seq = annotations = None
+    seen = 0
+
+    # Decoding state of the field of the current node being decoded, if any:
+    # its decoder entry, and whether it's the map of an Any/Many edge, of
+    # which mcount entries are left, with edge type medge, the nodes decoded
+    # so far (or None if the contents are not reached yet), and the number of
+    # elements of the contents array left to decode (None if indefinite, or
+    # False when not in the array).
+    entry = None
+    many = False
+    mcount = medge = nodes = size = None
+
+    while True:
+
+        # Continue decoding an Any/Many edge.
+        if many:
+            if size is not False:
+                if size is None:
+                    more = data[offset] != 0xFF
+                    if not more:
+                        offset += 1
+                else:
+                    more = size > 0
+                    size -= 1
+                if more:
+
+                    # Decode the next element.
+                    stack.append((count, typ, cls, node, decoders, edge, seq, annotations, seen, entry, many, mcount, medge, nodes, size))
+                    base = entry[4]
+                    count, offset = _decode_header(data, offset, 5, 'node description object must be a dict')
+                    typ = cls = node = decoders = edge = seq = annotations = None
+                    seen = 0
+                    many = False
+                    continue
+                size = False
+            if mcount is None:
+                more = data[offset] != 0xFF
+                if not more:
+                    offset += 1
+            else:
+                more = mcount > 0
+                mcount -= 1
+            if more:
+                key, offset = _decode_key(data, offset)
+                if key == '@d':
+                    size, offset = _decode_header(data, offset, 4, 'missing serialization of Any/Many contents')
+                    nodes = []
+                elif key == '@T':
+                    medge, offset = _decode_value(data, offset)
+                else:
+                    _, offset = _sub_cbor_to_py(data, offset)
+                continue
+            if medge != entry[3]:
+                raise ValueError('unexpected edge type for field ' + entry[1])
+            if nodes is None:
+                raise ValueError('missing serialization of Any/Many contents')
+            multi = entry[5]
+            children = multi.__new__(multi)
+            children._l = nodes
+            setattr(node, entry[2], children)
+            many = False
+            nodes = None
+            continue
+
+        # Decode the next entry of the map of the current node.
+        if count is None:
+            more = data[offset] != 0xFF
+            if not more:
+                offset += 1
+        else:
+            more = count > 0
+            count -= 1
+        if more:
+            key, offset = _decode_key(data, offset)
+            if decoders is not None:
+                entry = decoders.get(key, None)
+                if entry is not None:
+                    seen |= entry[0]
+                    kind = entry[3]
+                    if kind is None:
+                        value, offset = _decode_primitive(data, offset, key)
+                        if ctx.deferred is None:
+                            _load_primitive(node, entry, value, ctx)
+                        else:
+                            ctx.deferred.append((node, entry, value))
+                    elif kind in '*+':
+                        mcount, offset = _decode_header(data, offset, 5, 'missing or invalid serialization of Any/Many edge')
+                        many = True
+                        medge = nodes = None
+                        size = False
+                    elif kind in '@$':
+                        link, target, offset = _decode_link(data, offset)
+                        if link != kind:
+                            raise ValueError('unexpected edge type for field ' + key)
+                        setattr(node, entry[2], None)
+                        ctx.links.append((node, entry[2] if ctx.trusted else key, target))
+                    else:
+
+                        # Decode the child node.
+                        stack.append((count, typ, cls, node, decoders, edge, seq, annotations, seen, entry, many, mcount, medge, nodes, size))
+                        base = entry[4]
+                        count, offset = _decode_header(data, offset, 5, 'node description object must be a dict')
+                        typ = cls = node = decoders = edge = seq = annotations = None
+                        seen = 0
+                    continue
+            if key == '@i':
+                seq, offset = _decode_value(data, offset)
+            elif key == '@t':
+                if typ is not None:
+                    raise ValueError('duplicate type (@t) field in node serialization')
+                typ, offset = _decode_value(data, offset)
+                if typ is None:
+                    typ = False
+                    continue
+                cls = base._typemap.get(typ, None) if isinstance(typ, str) else None
+                if cls is None:
+                    raise ValueError('unknown node type (@t): ' + str(typ))
+                if not issubclass(cls, base) or cls._decoders is None:
+                    raise ValueError('unknown or unexpected type (@t) found in node serialization')
+                node = cls.__new__(cls)
+                node._annot = {}
+                decoders = cls._decoders
+            elif key == '@T':
+                edge, offset = _decode_value(data, offset)
+            elif key == '@S':
+                if ctx.deferred is None:
+                    raise _Unordered()
+                strings, offset = _sub_cbor_to_py(data, offset)
+                ctx.strings = [sys.intern(string) for string in strings]
+            elif key.startswith('{') and key.endswith('}'):
+                value, offset = _sub_cbor_to_py(data, offset)
+                if annotations is None:
+                    annotations = []
+                annotations.append([key[1:-1], value])
+            elif typ is None and not key.startswith('@'):
+                raise _Unordered()
+            else:
+                _, offset = _sub_cbor_to_py(data, offset)
+            continue
+
+        # The map of the current node is complete.
+        if cls is None:
+            if typ is None:
+                raise ValueError('type (@t) field is missing from node serialization')
+        else:
+
+            # Check that all fields were present.
+            if seen != cls._decoders_mask:
+                for key, decoder in cls._decoders.items():
+                    if not seen & decoder[0]:
+                        raise ValueError('missing or invalid serialization of field ' + key)
+
+            # Load annotations.
+            if annotations is not None:
+                for annotation in annotations:
+                    if ctx.deferred is None:
+                        node._load_annotation(node, annotation, ctx)
+                    else:
+                        ctx.deferred.append((node, None, annotation))
+
+            # Register node in sequence number lookup. Shared instances of
+            # field-less nodes are serialized without a sequence number by the
+            # C++ side.
+            if seq is not None or decoders:
+                if not isinstance(seq, int):
+                    raise ValueError('sequence number field (@i) is not an integer or missing from node serialization')
+                if seq in seq_to_ob:
+                    raise ValueError('duplicate sequence number %d' % seq)
+                seq_to_ob[seq] = node
+
+        # Return to the parent node, if any.
+        if not stack:
+            return node, edge, offset
+        child = node
+        child_edge = edge
+        count, typ, cls, node, decoders, edge, seq, annotations, seen, entry, many, mcount, medge, nodes, size = stack.pop()
+        if many:
+            if child_edge != '1':
+                raise ValueError('unexpected edge type for Any/Many element')
+            if child is None:
+                raise ValueError('type (@t) field is missing from node serialization')
+            nodes.append(child)
+        else:
+            if child_edge != entry[3]:
+                raise ValueError('unexpected edge type for field ' + entry[1])
+            setattr(node, entry[2], child)
+
+
+def _decode_link(data, offset):
+    """Decodes the map at the given offset of the given memoryview, which must
+    be the serialization of a Link or OptLink edge. Returns the edge type
+    (@T), the sequence number of the target or None, and the offset
+    following the map."""
+    count, offset = _decode_header(data, offset, 5, 'missing or invalid serialization of link')
+    edge = target = None
+    while True:
+        if count is None:
+            if data[offset] == 0xFF:
+                offset += 1
+                break
+        elif count:
+            count -= 1
+        else:
+            break
+        key, offset = _decode_key(data, offset)
+        if key == '@l':
+            target, offset = _decode_value(data, offset)
+        elif key == '@T':
+            edge, offset = _decode_value(data, offset)
+        else:
+            _, offset = _sub_cbor_to_py(data, offset)
+    return edge, target, offset
+
+
+def _decode_primitive(data, offset, name):
+    """Decodes the Python representation of the serialization of the primitive
+    field with the given name at the given offset of the given memoryview.
+    Returns it along with the offset following it."""
+    value, offset = _sub_cbor_to_py(data, offset)
+    if not isinstance(value, dict):
+        raise ValueError('missing or invalid serialization of field ' + name)
+    return value, offset
+
+
+def _load_primitive(node, entry, value, ctx):
+    """Loads the Python representation of the serialization of a primitive
+    field into the given node. entry is the decoder entry of the field."""
+    value = node._deserialize_primitive(entry[4], value)
+    setattr(node, entry[2] if ctx.trusted else entry[1], value)
+
+
 )PY";
 
+    // Generate the function that serializes the annotations of a node.
+    output << "def _serialize_annotations(node):" << std::endl;
+    format_doc(output,
+               "Returns the serialization keys and CBOR representations of the "
+               "annotations of the given node that can be serialized, sorted "
+               "by key.",
+               "    ");
+    output << "    annotations = []" << std::endl;
+    output << "    for key, val in node._annot.items():" << std::endl;
+    if (specification.py_serialize_fn.empty()) {
+        output << "        try:" << std::endl;
+        output << "            annotations.append(('{%s}' % key, _py_to_cbor(val)))" << std::endl;
+        output << "        except TypeError:" << std::endl;
+        output << "            pass" << std::endl;
+    } else {
+        output << "        annotations.append(('{%s}' % key, _py_to_cbor(" << specification.py_serialize_fn << "(key, val))))" << std::endl;
+    }
+    output << "    annotations.sort(key=lambda annotation: annotation[0])" << std::endl;
+    output << "    return annotations" << std::endl << std::endl << std::endl;
+
+    // Generate the function that loads an annotation decoded by the fused
+    // deserializer.
+    output << "def _load_annotation(node, annotation, ctx):" << std::endl;
+    format_doc(output,
+               "Loads the given annotation, a two-element list of the key and "
+               "the Python representation of the value, into the given node.",
+               "    ");
+    output << "    key, val = annotation" << std::endl;
+    if (specification.py_deserialize_fn.empty()) {
+        output << "    node[key] = val" << std::endl << std::endl << std::endl;
+    } else {
+        output << "    node[key] = " << specification.py_deserialize_fn << "(key, val)" << std::endl << std::endl << std::endl;
+    }
+
+    // Generate the functions that convert primitives to and from the Python
+    // representation of their CBOR serialization.
+    output << "def _serialize_primitive(typ, val):" << std::endl;
+    format_doc(output,
+               "Returns the CBOR serialization of the given value of the given "
+               "primitive type.",
+               "    ");
+    output << "    if hasattr(val, 'serialize_cbor'):" << std::endl;
+    output << "        return _py_to_cbor(val.serialize_cbor())" << std::endl;
+    if (specification.py_serialize_fn.empty()) {
+        output << "    raise ValueError('no serialization function seems to exist for field type ' + typ.__module__ + '.' + typ.__qualname__)" << std::endl << std::endl << std::endl;
+    } else {
+        output << "    return _py_to_cbor(" << specification.py_serialize_fn << "(typ, val))" << std::endl << std::endl << std::endl;
+    }
+    output << "def _deserialize_primitive(typ, field):" << std::endl;
+    format_doc(output,
+               "Returns the value of the given primitive type represented by "
+               "the Python representation of its CBOR serialization.",
+               "    ");
+    output << "    if hasattr(typ, 'deserialize_cbor'):" << std::endl;
+    output << "        return typ.deserialize_cbor(field)" << std::endl;
+    if (specification.py_deserialize_fn.empty()) {
+        output << "    raise ValueError('no deserialization function seems to exist for field type ' + typ.__module__ + '.' + typ.__qualname__)" << std::endl << std::endl << std::endl;
+    } else {
+        output << "    return " << specification.py_deserialize_fn << "(typ, field)" << std::endl << std::endl << std::endl;
+    }
+
+    // The traversal methods of Node may also process the nodes of other trees
+    // (through external edges), so they look these functions up through the
+    // node rather than globally.
+    output << "Node._serialize_annotations = staticmethod(_serialize_annotations)" << std::endl;
+    output << "Node._load_annotation = staticmethod(_load_annotation)" << std::endl;
+    output << "Node._serialize_primitive = staticmethod(_serialize_primitive)" << std::endl;
+    output << "Node._deserialize_primitive = staticmethod(_deserialize_primitive)" << std::endl << std::endl << std::endl;
+
     // Generate the node classes.
     std::unordered_set<std::string> generated;
     for (auto node : nodes) {
@@ -1339,6 +1862,18 @@ def _cloned(obj):
         }
     }
 
+    // Register the field tables of the node classes. This is done after all
+    // classes are defined, as the tables may refer to any of them.
+    output << "# Field tables of the node classes, see _register()." << std::endl;
+    for (auto &node : nodes) {
+        if (node->derived.empty()) {
+            generate_field_table(output, *node);
+        }
+    }
+
+    // Write the file if it changed.
+    write_if_changed(python_filename, output.str());
+
 }
 
 } // namespace python
@@ -2,9 +2,14 @@
  * Main source file for \ref tree-gen.
  */
 
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
 #include "tree-gen.hpp"
 #include "tree-gen-cpp.hpp"
 #include "tree-gen-python.hpp"
+#include "tree-gen-bindings.hpp"
 #include "parser.hpp"
 #include "lexer.hpp"
 
@@ -54,6 +59,38 @@ std::string replace_all(std::string str, const std::string &from, const std::str
     return str;
 }
 
+/**
+ * Writes the given contents to the given file, unless the file already has
+ * exactly these contents. This keeps the timestamps of unchanged outputs
+ * intact, so build systems don't rebuild anything that depends on them.
+ * Returns whether the file was written. Prints an error message and exits if
+ * the file could not be written.
+ */
+bool write_if_changed(const std::string &filename, const std::string &contents) {
+    {
+        std::ifstream existing(filename, std::ios::binary);
+        if (existing.is_open()) {
+            std::ostringstream ss;
+            ss << existing.rdbuf();
+            if (ss.str() == contents) {
+                return false;
+            }
+        }
+    }
+    std::ofstream output(filename, std::ios::binary);
+    if (!output.is_open()) {
+        std::cerr << "Failed to open " << filename << " for writing" << std::endl;
+        std::exit(1);
+    }
+    output << contents;
+    output.close();
+    if (!output) {
+        std::cerr << "Failed to write " << filename << std::endl;
+        std::exit(1);
+    }
+    return true;
+}
+
 /**
  * Construct a node with the given snake_case name and class documentation.
  */
@@ -62,6 +99,8 @@ NodeBuilder::NodeBuilder(const std::string &name, const std::string &doc) {
     node->snake_case_name = name;
     node->doc = doc;
     node->is_error_marker = false;
+    node->may_contain_links = false;
+    node->may_be_incomplete = false;
 
     // Generate title case name.
     auto snake_ss = std::stringstream(name);
@@ -89,7 +128,8 @@ NodeBuilder *NodeBuilder::with_child(
     EdgeType type,
     const std::string &node_name,
     const std::string &name,
-    const std::string &doc
+    const std::string &doc,
+    bool is_inline
 ) {
     auto child = Field();
     child.type = type;
@@ -99,6 +139,7 @@ NodeBuilder *NodeBuilder::with_child(
     child.name = name;
     child.doc = doc;
     child.ext_type = type;
+    child.is_inline = is_inline;
     node->fields.push_back(std::move(child));
     return this;
 }
@@ -110,8 +151,12 @@ NodeBuilder *NodeBuilder::with_prim(
     const std::string &prim,
     const std::string &name,
     const std::string &doc,
-    EdgeType type
+    EdgeType type,
+    bool cold
 ) {
+    if (cold && type != Prim) {
+        throw std::runtime_error("only primitive fields can be cold: " + name);
+    }
     auto child = Field();
     child.type = Prim;
     switch (type) {
@@ -135,6 +180,7 @@ NodeBuilder *NodeBuilder::with_prim(
     child.name = name;
     child.doc = doc;
     child.ext_type = type;
+    child.cold = cold;
     node->fields.push_back(std::move(child));
     return this;
 }
@@ -237,6 +283,30 @@ void Specification::set_source_location(const std::string &ident) {
     source_location = ident;
 }
 
+/**
+ * Sets the heap size function for primitives.
+ */
+void Specification::set_heap_size_function(const std::string &heap_size_fn) {
+    if (!this->heap_size_fn.empty()) {
+        throw std::runtime_error("duplicate heap size function declaration");
+    }
+    this->heap_size_fn = heap_size_fn;
+}
+
+/**
+ * Enables member layout optimization for the generated C++ node classes.
+ */
+void Specification::set_optimize_layout() {
+    optimize_layout = true;
+}
+
+/**
+ * Enables compact source location slots in the generated C++ node classes.
+ */
+void Specification::set_compact_location() {
+    compact_location = true;
+}
+
 /**
  * Adds an include statement to the header file.
  */
@@ -279,6 +349,86 @@ void Specification::add_node(std::shared_ptr<NodeBuilder> &node_builder) {
     builders.insert(std::make_pair(name, node_builder));
 }
 
+/**
+ * Throws an error if the node types stored inline in the given node type
+ * (directly or indirectly) include the node type itself.
+ */
+static void check_inline_cycles(const Node &node, std::vector<const Node*> &stack) {
+    for (const auto &other : stack) {
+        if (other == &node) {
+            throw std::runtime_error("inline edges form a cycle through node " + node.snake_case_name);
+        }
+    }
+    stack.push_back(&node);
+    for (const auto &field : node.all_fields()) {
+        if (field.is_inline) {
+            check_inline_cycles(*field.node_type, stack);
+        }
+    }
+    stack.pop_back();
+}
+
+/**
+ * Computes the may_contain_links and may_be_incomplete flags of all the given
+ * nodes. Both are propagated from the leaf types to their ancestors and from
+ * child node types to the node types that contain them, until nothing changes
+ * anymore.
+ */
+static void analyze_reachability(const Nodes &nodes) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto &node : nodes) {
+            bool links = node->may_contain_links;
+            bool incomplete = node->may_be_incomplete;
+            if (node->derived.empty()) {
+                incomplete |= node->is_error_marker;
+                for (const auto &field : node->all_fields()) {
+                    switch (field.type) {
+                        case Maybe:
+                            break;
+                        case One:
+                            incomplete |= !field.is_inline;
+                            break;
+                        case Any:
+                        case Many:
+                            // The entries of an Any or Many edge are One
+                            // edges, which may be empty.
+                            incomplete = true;
+                            break;
+                        case OptLink:
+                        case Link:
+                            links = true;
+                            incomplete = true;
+                            break;
+                        case Prim:
+                            if (field.ext_type != Prim) {
+                                links = true;
+                                incomplete = true;
+                            }
+                            break;
+                    }
+                    if (field.node_type) {
+                        links |= field.node_type->may_contain_links;
+                        incomplete |= field.node_type->may_be_incomplete;
+                    }
+                }
+            } else {
+                for (const auto &derived_weak : node->derived) {
+                    auto derived = derived_weak.lock();
+                    links |= derived->may_contain_links;
+                    incomplete |= derived->may_be_incomplete;
+                }
+            }
+            if (links != node->may_contain_links || incomplete != node->may_be_incomplete) {
+                node->may_contain_links = links;
+                node->may_be_incomplete = incomplete;
+                changed = true;
+            }
+        }
+    }
+}
+
 /**
  * Checks for errors, resolves node names, and builds the nodes vector.
  */
@@ -303,6 +453,19 @@ void Specification::build() {
         }
         nodes.push_back(it.second->node);
     }
+    for (auto &node : nodes) {
+        for (auto &field : node->fields) {
+            if (field.is_inline && !field.node_type->derived.empty()) {
+                throw std::runtime_error(
+                    "inline edge " + field.name + " refers to non-leaf node " +
+                    field.node_type->snake_case_name
+                );
+            }
+        }
+        std::vector<const Node*> stack;
+        check_inline_cycles(*node, stack);
+    }
+    analyze_reachability(nodes);
 }
 
 }
@@ -316,9 +479,35 @@ int main(
 ) {
     using namespace tree_gen;
 
+    // Parse options.
+    size_t parts = 0;
+    std::string bindings_header;
+    std::string bindings_source;
+    while (argc > 1 && std::string(argv[1]).substr(0, 2) == "--") {
+        auto option = std::string(argv[1]);
+        if (option == "--split" && argc > 2) {
+            parts = std::strtoul(argv[2], nullptr, 10);
+            argc -= 2;
+            argv += 2;
+        } else if (option == "--python-bindings" && argc > 3) {
+            bindings_header = argv[2];
+            bindings_source = argv[3];
+            argc -= 3;
+            argv += 3;
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
     // Check command line and open files.
     if (argc < 4 || argc > 5) {
-        std::cerr << "Usage: tree-gen <spec-file> <header-file> <source-file> [python-file]" << std::endl;
+        std::cerr << "Usage: tree-gen [--split <parts>] [--python-bindings <header-file> <source-file>] ";
+        std::cerr << "<spec-file> <header-file> <source-file> [python-file]" << std::endl;
+        return 1;
+    }
+    if (!bindings_source.empty() && argc < 5) {
+        std::cerr << "--python-bindings requires the python-file to be generated as well" << std::endl;
         return 1;
     }
 
@@ -361,12 +550,22 @@ int main(
     fclose(fptr);
 
     // Generate C++ code.
-    cpp::generate(argv[2], argv[3], specification);
+    cpp::generate(argv[2], argv[3], specification, parts);
 
     // Generate Python code if requested.
     if (argc >= 5) {
         python::generate(argv[4], specification);
     }
 
+    // Generate Python bindings for the C++ code if requested.
+    if (!bindings_source.empty()) {
+        try {
+            bindings::generate(bindings_header, bindings_source, argv[2], argv[4], specification);
+        } catch (std::exception &e) {
+            std::cerr << "Failed to generate Python bindings: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     return 0;
 }
@@ -143,8 +143,11 @@
  *     # [documentation for primitive]
  *     [snake_case_member_name]: [C++ namespace path];
  *
+ *     # [documentation for rarely used primitive]
+ *     cold [snake_case_member_name]: [C++ namespace path];
+ *
  *     # [documentation for edge/child node]
- *     [snake_case_member_name]: [Maybe|One|Any|Many|OptLink|Link]<[snake_case_node_name]>;
+ *     [snake_case_member_name]: [Maybe|One|Inline|Any|Many|OptLink|Link]<[snake_case_node_name]>;
  *
  *     # [documentation for external edge/child node]
  *     [snake_case_member_name]: external [Maybe|One|Any|Many|OptLink|Link]<[C++ namespace path]>;
@@ -205,6 +208,34 @@
  * specified in the list will automatically appear at the end, using the default
  * order.
  *
+ * `Inline` edges behave like `One` edges, except that in C++ the child node is
+ * stored by value inside the parent, as an `Inline<T>` from the support
+ * library, rather than in a separate heap allocation. This saves an
+ * allocation and a pointer indirection for small nodes, but is only possible
+ * when the type of the child is fixed, so the node type must be a leaf type.
+ * Inline edges can't form a cycle, and nodes stored inline can't be the
+ * target of a link. In Python and in the serialization format, `Inline`
+ * edges are no different from `One` edges.
+ *
+ * Primitives that are rarely set to anything but their default value, such as
+ * documentation strings or debug information, can be marked `cold`. In C++,
+ * such fields are stored as a `Cold<T>` from the support library rather than
+ * as a `T`. This only stores a pointer in the node, and allocates the value
+ * on the heap when it is set to something other than a default-constructed
+ * `T`, making the nodes smaller. Cold fields are read using `get()` or the
+ * implicit conversion to `const T&`, and written by assigning a `T` or
+ * through the reference returned by `mutate()`. In Python, cold fields are
+ * no different from other fields.
+ *
+ * Leaf node types without any fields carry no information other than their
+ * type, so in C++ they get a static `shared()` function that returns a
+ * process-wide shared instance, to avoid an allocation for each use. Unlike
+ * other nodes, a shared instance may appear any number of times in a tree;
+ * `is_shared()` tells them apart from ordinary nodes. Shared instances are
+ * serialized without a sequence number, and deserialize back to the shared
+ * instance. They must not be modified or annotated, and can't be the target
+ * of a link. Copies and clones of a shared instance are ordinary nodes.
+ *
  * \section directive Directives
  *
  * The following directives exist. They should be placed at the top of the tree
@@ -250,6 +281,32 @@
  *    overload for the class. The base class needs to be capable of annotations
  *    if you use this. This is not supported in Python.
  *
+ *  - `heap_size_function <namespace::path::heap_size>`: optionally, the name
+ *    (including namespace path leading up to it) of the function template
+ *    used to determine how many bytes of heap memory a primitive uses, for
+ *    memory usage reports. It is called as `heap_size<T>(const T&)` and
+ *    should return a `size_t`. If not specified, primitives are assumed not
+ *    to use any heap memory. Unused in Python.
+ *
+ *  - `optimize_layout`: optionally, store the members of the generated C++
+ *    node classes in order of decreasing alignment rather than in declaration
+ *    order, to minimize the padding between them. The order of the
+ *    constructor parameters, dumps, and serialized fields is not affected.
+ *    The generator can't know the alignment of every primitive type, so it
+ *    recognizes the builtin and `<cstdint>` integer and floating point types
+ *    and assumes pointer alignment for everything else; edges are always
+ *    pointer-aligned. Unused in Python.
+ *
+ *  - `compact_location`: optionally, give every generated C++ node a slot for
+ *    a `tree::location::SourceLocation`, accessible using `get_location()`
+ *    and `set_location()`. Unlike the annotation-based `location` directive,
+ *    this costs only 8 bytes per node and no allocation: the file name is
+ *    stored once in a process-wide table. The dumper prints the location of
+ *    each node that has one, and serialization writes the locations of all
+ *    nodes in a single, delta-encoded column at the end of the root node
+ *    rather than in each node (see `tree::location::LocationColumn`). The
+ *    support library must be used if you use this. Python ignores the column.
+ *
  *  - `include "<path>"`: adds an `#include` statement to the top of the
  *    generated C++ header file.
  *
@@ -265,6 +322,41 @@
  *    docstring in front is used to document the innermost namespace
  *    javadoc-style for Doxygen documentation. This is not used in Python.
  *
+ * \section invocation Invocation
+ *
+ * tree-gen is invoked as
+ *
+ * ```
+ * tree-gen [--split <parts>] <spec-file> <header-file> <source-file> [python-file]
+ * ```
+ *
+ * Normally, all C++ code is generated into a single header and a single
+ * source file. For large trees, the source file can take a long time to
+ * compile. With `--split`, the implementations of the node classes are
+ * instead distributed over the given number of additional source files,
+ * named by inserting `-0`, `-1`, and so on before the extension of the
+ * source filename, such that they can be compiled in parallel. The node
+ * classes are sorted by a hash of their name and dealt out over these files
+ * round-robin, so the files are about equally large. The visitor classes and
+ * everything else remain in the main source file. The header is split up as
+ * well: everything that only depends on the names of the node types goes in
+ * a forward declaration header, named by inserting `-fwd` before the
+ * extension of the header filename, and each node class is defined in a
+ * header of its own, named by inserting `-node-` and the snake_case name of
+ * the node type. The main header includes all of these, but each part only
+ * includes the headers of the classes it needs, so a change to a node type
+ * only rebuilds the parts that use it. Each file that includes node headers
+ * also contains a digest of them, so it changes along with them; build
+ * systems thus don't need to know the names of the node headers. The
+ * `generate_tree_split()` CMake function takes care of this.
+ *
+ * tree-gen generates all output in memory first, and only writes the output
+ * files whose contents changed. Their timestamps are thus left alone when
+ * regenerating a tree produces the same code, such that build systems that
+ * check whether outputs were actually modified (like Ninja, as used by CMake)
+ * don't rebuild anything. In split mode, this applies to each file
+ * individually.
+ *
  * \section apis Generated APIs
  *
  * The following methods are generated for each node class:
@@ -278,7 +370,9 @@
  *    OptLinks reachable from the root node).
  *
  *  - `%NodeType type() const`: returns the type of this node, using the
- *    also-generated %NodeType enumeration.
+ *    also-generated %NodeType enumeration. In C++, this is an inline function
+ *    of the `Node` base class that returns a tag set by the constructor of
+ *    the leaf class, so it does not involve a virtual call.
  *
  *  - `One<Node> copy() const`: returns a shallow copy of this node.
  *
@@ -294,12 +388,21 @@
  *  - `void dump(std::ostream &out=std::cout, int indent=0)`: does a debug
  *    dump of the node to the given stream with the given indentation level.
  *
+ *  - `void memory_usage(MemoryReport &report)` (C++ only): adds the memory
+ *    used by this node and its children to the given report. See
+ *    \ref memory.
+ *
  *  - `SomeNodeType *as_some_node_type()` (C++ only): does the equivalent of a
  *    `dynamic_cast` to the given node type, returning `this` if the type is
  *    correct or `nullptr` if not.
  *
  * Note that the prototypes for the Python equivalents differ as appropriate.
  *
+ * In C++, the classes for leaf node types (those that no other node type
+ * derives from) and their overrides of the above are declared `final`. This
+ * allows the compiler to call them without going through the vtable whenever
+ * the static type of a node is known, for example after `as_some_node_type()`.
+ *
  * An implicit node class simply named `Node` is always generated, serving as
  * the base class for all other nodes. In C++, it is what derives from the
  * `Base` class defined in the namespace specified using `tree_namespace`. In
@@ -333,7 +436,16 @@
  *    `RecursiveVisitor`, the default implementation for non-leaf node types
  *    recursively calls `visit()` for all child nodes, thus recursively
  *    traversing the tree. For leaf nodes, both visitor classes have the same
- *    behavior.
+ *    behavior. A third class, `MemoVisitor<T>`, behaves like `Visitor<T>`,
+ *    but caches the result of visiting each node, so visiting a node again
+ *    (for instance through multiple links) returns the cached result. Its
+ *    `invalidate()` and `clear()` methods must be used to discard results
+ *    for nodes that have been modified or destroyed since. Finally,
+ *    `FusedVisitor` calls any number of non-recursive `Visitor<void>`s for
+ *    every node in a single traversal. The generated `PassManager` uses it
+ *    to run sequences of passes in as few traversals as possible, based on
+ *    the annotation types that each pass declares to read and write. See
+ *    tree::pass for details.
  *
  *  - *Using the `as_*()` methods.* Given for instance an expression node, you
  *    might do
@@ -364,6 +476,20 @@
  *    switch based on the type and don't need access to members of the nodes
  *    this is more descriptive than the if/else form.
  *
+ *  - *Using the reflection information.* For each node class `T`, a
+ *    `NodeTraits<T>` specialization is generated, providing its name, whether
+ *    it is a leaf type, which `NodeType`s it covers, and for leaf types the
+ *    number of fields and a `for_each_field(node, f)` function that calls
+ *    `f(name, field)` for each field. The kind of a field can be determined
+ *    at compile time using `field_kind` from the support library, and the
+ *    nodes owned by a field can be iterated using `for_each_child()`.
+ *    `dispatch(node, f)` calls `f` with the node cast to its leaf type, and
+ *    `for_each_node(root, f)` does so for all nodes in a tree in pre-order,
+ *    using an explicit stack. This allows whole-tree algorithms such as
+ *    hashing or statistics to be written once, as a functor with templated
+ *    call operators, and still be specialized by the compiler for each node
+ *    type without any virtual calls.
+ *
  * Just choose the method that makes the most sense within context. Python is
  * so much more dynamic in general that you're better off using its duck typing
  * functionality or using `isinstance()` directly, so no special features are
@@ -529,6 +655,119 @@
  * The commonly used keys and values are short to minimize serialization and
  * deserialization overhead.
  *
+ * \subsubsection compression Compression
+ *
+ * Serialized trees are very repetitive, so they compress well. The
+ * tree::base::serialize_compressed() entry point (or the
+ * `SERIALIZE_COMPRESSED` option of tree::base::serialize_file()) wraps the CBOR in a frame consisting of
+ * independently compressed blocks, using the small LZ-family codec in
+ * tree::compress. The preset dictionary for the codec is derived from the
+ * tree description and is returned by the generated static
+ * `Node::compression_dictionary()` function, such that even small trees
+ * compress well. tree::base::deserialize() and
+ * tree::base::deserialize_file() detect compressed frames automatically. The
+ * Python generator does not support compressed frames; use
+ * tree::compress::decompress() to convert them to plain CBOR if needed.
+ *
+ * \subsubsection integrity Integrity checks
+ *
+ * Deserialization normally validates both the CBOR structure and the
+ * well-formedness of the resulting tree, because it cannot know where the
+ * data came from. tree::base::serialize_checked() (or the
+ * `SERIALIZE_CHECKED` option of tree::base::serialize_file()) wraps the CBOR
+ * in an integrity frame containing a CRC32C checksum, a "validated on write"
+ * flag, and a fingerprint of the tree description as returned by the
+ * generated static `Node::schema_fingerprint()` function. When
+ * tree::base::deserialize() encounters such a frame, it verifies the
+ * checksum (using the SSE4.2 or ARMv8 CRC instructions when available), but
+ * still validates the tree: a checksum is not a signature, so anyone can
+ * produce a frame that checks out. For data from a trusted source, such as
+ * a cache written by the same program, tree::base::deserialize_trusted()
+ * skips the validation steps if the frame was validated when written and
+ * the fingerprint matches. Like compression, this is not supported by the
+ * Python generator.
+ *
+ * \subsubsection canonical Canonical encoding and content hashes
+ *
+ * By default, the bytes produced for a tree depend on details that have
+ * nothing to do with its contents, such as the encoding chosen for floats.
+ * tree::base::serialize_canonical() (or the `SERIALIZE_CANONICAL` option of
+ * tree::base::serialize_file()) produces a canonical encoding instead: all
+ * integers and floats use their shortest exact CBOR encoding, annotations
+ * are written in order of their serialization key, and link targets are
+ * numbered in depth-first order, as always. Equal trees then serialize to
+ * equal bytes, provided that the primitive serialization functions are
+ * deterministic as well.
+ *
+ * tree::base::content_hash() computes a SHA-256 Merkle hash from the
+ * canonical encoding. The hash of each node is computed from its type, its
+ * field values and annotations, and the hashes of the nodes below it. Links
+ * contribute the sequence number of their target relative to the node that
+ * contains them, so the hash of a node does not depend on where it is in the
+ * tree, as long as the links below it point to nodes below it as well.
+ * tree::base::HashIndex computes the hashes of all nodes of a tree in a
+ * single pass. It is a snapshot, so it must be rebuilt after the tree is
+ * modified. tree::base::ContentStore uses these hashes to store serialized
+ * trees and subtrees in a directory, such that identical trees are only
+ * written once and can be looked up by hash, for instance to cache the
+ * results of expensive passes. The Python generator reads canonical
+ * trees, but cannot produce them.
+ *
+ * \subsubsection stats Instrumentation
+ *
+ * To find out where the time goes when (de)serialization is slow, the support
+ * library can count nodes, bytes, CBOR containers, restored links, and
+ * validation passes, and time the find-reachable, check-complete, encode,
+ * decode, and restore-links phases. This is compiled out unless the
+ * `TREE_STATS` configuration macro is set to 1 for both the support library
+ * and the generated code. The `TREE_GEN_STATS` CMake option does that by
+ * adding it to the public compile definitions of the tree-lib target. The statistics are collected by
+ * tree::stats::Collector objects, and are returned directly by
+ * tree::base::serialize_with_stats() and
+ * tree::base::deserialize_with_stats(). A hook installed with
+ * tree::stats::set_hook() receives the statistics of every collector when it
+ * finishes.
+ *
+ * \subsubsection batch Batch processing
+ *
+ * To deserialize, transform, and reserialize many independent trees,
+ * tree::base::process_batch() and tree::base::process_stream() distribute
+ * the trees over a pool of worker threads. Each worker reuses its output
+ * buffer for all the trees it processes. Inputs are only fetched when a
+ * worker is ready for them, and tree::base::BatchOptions can limit the total
+ * size of the inputs being processed at any time, to bound memory usage.
+ * This is not supported in Python.
+ *
+ * \subsection attributes Attribute evaluation
+ *
+ * Passes that compute properties of nodes, such as types, scopes, or sizes,
+ * can declare these as attributes using the tree::attribute namespace of the
+ * support library. An attribute consists of a name and an equation that
+ * computes its value for a given node, possibly using the values of other
+ * attributes of the same or other nodes. A tree::attribute::Evaluator
+ * evaluates attributes on demand, caches their values in an annotation on the
+ * node, and records which attributes were used to compute which. After a node
+ * is modified, tree::attribute::Evaluator::changed() invalidates only the
+ * attributes that (transitively) depend on it, so the next request recomputes
+ * only those. Attributes are declared in C++, not in the tree description
+ * file. This is not supported in Python.
+ *
+ * \subsection memory Memory usage
+ *
+ * To find out which node types take up the most memory, call
+ * `tree::base::memory_usage(root)`. This returns a tree::base::MemoryReport
+ * that lists, per node type and per annotation type, the number of instances
+ * and an estimate of the number of bytes used, split up into the node
+ * objects themselves, their shared_ptr control blocks, the heap storage of
+ * `Any`/`Many` edges, the heap storage of primitives, and annotations. Its
+ * `dump()` method prints the report as a table. Links do not own their
+ * target, so they are not followed. Heap memory used by primitives is only
+ * accounted for if a `heap_size_function` directive is specified; the
+ * heap memory used by annotation types can likewise be accounted for by
+ * specializing tree::annotatable::heap_size(). The numbers are estimates:
+ * allocator overhead and the internals of the standard library are only
+ * approximated. This is not supported in Python.
+ *
  * \subsection python Python support
  *
  * In addition to C++, tree-gen can also generate pure-Python objects to
@@ -561,6 +800,53 @@
  * and Python worlds (for example through swig); tree-gen just ensures that the
  * Python and C++ tree implementations always remain in sync.
  *
+ * The generated Python code converts between CBOR and Python objects in pure
+ * Python by default. If the `tree_gen_cbor` extension module in `python/`
+ * (built when the `TREE_GEN_BUILD_PYTHON_CBOR` CMake option is set) can be
+ * imported, it is used instead, which is much faster for large trees. Both
+ * behave the same, aside from the type of the exception raised for some
+ * kinds of malformed input.
+ *
+ * Without the extension module, `Node.deserialize()` decodes CBOR bytes into
+ * nodes directly, rather than building the intermediate dict/list
+ * representation first. This uses several times less memory while loading.
+ * Passing `trusted=True` skips the type checks of the field setters for
+ * primitives and links, for input known to come from a matching tree-gen
+ * serializer. If the extension module is used, but fails to decode a tree
+ * because it is nested deeper than the Python recursion limit, the direct
+ * decoder is used instead.
+ *
+ * Rather than emitting traversal methods for each node class, the generator
+ * emits a table describing the fields of each class, registered with
+ * `_register()` at the end of the module. The serialization, deserialization,
+ * equality, `find_reachable()`, `check_complete()`, `clone()` and `dump()`
+ * methods of the `Node` base class dispatch on these tables and keep their
+ * state on an explicit stack instead of recursing, so trees of any depth can
+ * be processed.
+ *
+ * Alternatively, passing `--python-bindings <header-file> <source-file>` to
+ * tree-gen (or using the `generate_tree_py_bindings` CMake function)
+ * generates a CPython extension module, named after the source file, that
+ * wraps the C++ nodes themselves. Its classes have the same names,
+ * constructors, and attributes as the pure-Python ones, but every attribute
+ * access reads or modifies the C++ tree directly, so a tree can be handed
+ * from C++ to Python and back without serializing it. The header declares
+ * `python::to_proxy()` and `python::from_proxy()` in the tree namespace to
+ * convert between `Maybe<Node>` and proxy objects. Some differences remain:
+ *
+ *  - proxy objects are created on every access, so compare them using `==`
+ *    (which compares the C++ trees) rather than `is`;
+ *  - primitives are converted between their C++ and Python types using
+ *    the serdes functions of both languages, so a serdes function pair must
+ *    be specified, and the pure-Python module must be importable;
+ *  - `Inline` edges can't be reassigned, but the fields of the node in them
+ *    can be;
+ *  - edges to nodes from another tree are not exposed;
+ *  - Python annotations are stored in the C++ nodes, but are not serialized.
+ *
+ * `to_python()` and the module-level `from_python()` and `deserialize()`
+ * functions convert to and from the pure-Python classes and CBOR.
+ *
  * The serialization and deserialization functions naturally have a different
  * signature in Python than they do in C++. More specifically, the functions
  * must look like this:
@@ -725,6 +1011,20 @@ struct Field {
      * another tree.
      */
     EdgeType ext_type;
+
+    /**
+     * Whether this field is rarely used, and should therefore be stored in a
+     * separate heap allocation rather than inline (C++ only). Only valid for
+     * primitives.
+     */
+    bool cold;
+
+    /**
+     * Whether this is a One edge of which the node is stored by value inside
+     * the parent rather than through a pointer (C++ only). The node type must
+     * be a leaf type.
+     */
+    bool is_inline;
 };
 
 /**
@@ -772,6 +1072,22 @@ struct Node {
      */
     bool is_error_marker;
 
+    /**
+     * Whether a subtree rooted at a node of this type or a type derived from
+     * it can contain Link or OptLink edges. Edges to nodes from another tree
+     * are assumed to possibly contain links. Computed by
+     * Specification::build().
+     */
+    bool may_contain_links;
+
+    /**
+     * Whether a subtree rooted at a node of this type or a type derived from
+     * it can fail the completeness check, because it can contain One, Any,
+     * Many, Link or OptLink edges, error markers, or edges to nodes from
+     * another tree. Computed by Specification::build().
+     */
+    bool may_be_incomplete;
+
     /**
      * Gathers all child nodes, including those in parent classes.
      */
@@ -790,6 +1106,15 @@ using Nodes = std::vector<std::shared_ptr<Node>>;
  */
 std::string replace_all(std::string str, const std::string& from, const std::string& to);
 
+/**
+ * Writes the given contents to the given file, unless the file already has
+ * exactly these contents. This keeps the timestamps of unchanged outputs
+ * intact, so build systems don't rebuild anything that depends on them.
+ * Returns whether the file was written. Prints an error message and exits if
+ * the file could not be written.
+ */
+bool write_if_changed(const std::string &filename, const std::string &contents);
+
 /**
  * Convenience class for constructing a node.
  */
@@ -818,7 +1143,8 @@ public:
         EdgeType type,
         const std::string &node_name,
         const std::string &name,
-        const std::string &doc = ""
+        const std::string &doc = "",
+        bool is_inline = false
     );
 
     /**
@@ -828,7 +1154,8 @@ public:
         const std::string &prim,
         const std::string &name,
         const std::string &doc = "",
-        EdgeType type = Prim
+        EdgeType type = Prim,
+        bool cold = false
     );
 
     /**
@@ -948,6 +1275,25 @@ public:
      */
     std::string source_location;
 
+    /**
+     * The function used to determine the heap memory used by primitives, or
+     * empty if primitives are assumed not to use any.
+     */
+    std::string heap_size_fn;
+
+    /**
+     * Whether the members of the generated C++ node classes should be stored
+     * in order of decreasing alignment rather than in declaration order, to
+     * minimize padding.
+     */
+    bool optimize_layout = false;
+
+    /**
+     * Whether the generated C++ node classes should have a dedicated slot
+     * for a compact source location.
+     */
+    bool compact_location = false;
+
     /**
      * All the nodes.
      */
@@ -998,6 +1344,22 @@ public:
      */
     void set_source_location(const std::string &ident);
 
+    /**
+     * Sets the heap size function for primitives.
+     */
+    void set_heap_size_function(const std::string &heap_size_fn);
+
+    /**
+     * Enables member layout optimization for the generated C++ node classes.
+     */
+    void set_optimize_layout();
+
+    /**
+     * Enables compact source location slots in the generated C++ node
+     * classes.
+     */
+    void set_compact_location();
+
     /**
      * Adds an include statement to the header file.
      */
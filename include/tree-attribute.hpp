@@ -0,0 +1,11 @@
+/** \file
+ * Contains the incremental attribute evaluation framework for trees.
+ */
+
+#pragma once
+
+#include "tree-annotatable.hpp"
+
+#include "tree-default-config.hpp.inc"
+#include "tree-attribute.hpp.inc"
+#include "tree-undef.hpp.inc"
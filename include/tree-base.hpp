@@ -5,8 +5,16 @@
 #pragma once
 
 #include "tree-compat.hpp"
+#include "tree-stats.hpp"
 #include "tree-annotatable.hpp"
+#include "tree-attribute.hpp"
+#include "tree-parallel.hpp"
+#include "tree-pass.hpp"
 #include "tree-cbor.hpp"
+#include "tree-compress.hpp"
+#include "tree-checksum.hpp"
+#include "tree-intern.hpp"
+#include "tree-location.hpp"
 
 #include "tree-default-config.hpp.inc"
 #include "tree-base.hpp.inc"
@@ -0,0 +1,9 @@
+/** \file
+ * Contains the integrity checks used for checksummed serialized trees.
+ */
+
+#pragma once
+
+#include "tree-default-config.hpp.inc"
+#include "tree-checksum.hpp.inc"
+#include "tree-undef.hpp.inc"
@@ -0,0 +1,9 @@
+/** \file
+ * Contains the block compression layer used for compressed serialized trees.
+ */
+
+#pragma once
+
+#include "tree-default-config.hpp.inc"
+#include "tree-compress.hpp.inc"
+#include "tree-undef.hpp.inc"
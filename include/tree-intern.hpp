@@ -0,0 +1,12 @@
+/** \file
+ * Contains the interned string type, which can be used as a primitive for
+ * fields holding mostly duplicate strings.
+ */
+
+#pragma once
+
+#include "tree-cbor.hpp"
+
+#include "tree-default-config.hpp.inc"
+#include "tree-intern.hpp.inc"
+#include "tree-undef.hpp.inc"
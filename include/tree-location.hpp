@@ -0,0 +1,13 @@
+/** \file
+ * Contains the compact source location type and the location column used to
+ * serialize the source locations of a tree.
+ */
+
+#pragma once
+
+#include "tree-cbor.hpp"
+#include "tree-intern.hpp"
+
+#include "tree-default-config.hpp.inc"
+#include "tree-location.hpp.inc"
+#include "tree-undef.hpp.inc"
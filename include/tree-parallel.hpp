@@ -0,0 +1,9 @@
+/** \file
+ * Contains the utilities used to process trees concurrently.
+ */
+
+#pragma once
+
+#include "tree-default-config.hpp.inc"
+#include "tree-parallel.hpp.inc"
+#include "tree-undef.hpp.inc"
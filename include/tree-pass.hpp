@@ -0,0 +1,11 @@
+/** \file
+ * Contains the pass manager used to run passes over trees.
+ */
+
+#pragma once
+
+#include "tree-parallel.hpp"
+
+#include "tree-default-config.hpp.inc"
+#include "tree-pass.hpp.inc"
+#include "tree-undef.hpp.inc"
@@ -0,0 +1,9 @@
+/** \file
+ * Contains the optional instrumentation of the tree support library.
+ */
+
+#pragma once
+
+#include "tree-default-config.hpp.inc"
+#include "tree-stats.hpp.inc"
+#include "tree-undef.hpp.inc"
@@ -0,0 +1,747 @@
+/** \file
+ * Optional CPython extension module that speeds up the conversion between
+ * CBOR and its Python representation in the Python modules generated by
+ * tree-gen.
+ *
+ * Generated modules import this module if it is available and fall back to
+ * their pure-Python implementation otherwise. Both behave the same: the
+ * decoder supports exactly the subset of CBOR described in the generated
+ * `_cbor_to_py()`, and the encoder produces the same bytes as the generated
+ * `_py_to_cbor()`, i.e. definite-length arrays and maps, maps sorted by key,
+ * and all floats in double precision. The only difference is that malformed
+ * input always raises a ValueError, where the pure-Python decoder may raise
+ * other exceptions for truncated data.
+ *
+ * The module only uses the CPython C API and the C++ standard library.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+/**
+ * Version of the interface between this module and the generated Python
+ * code. Generated code only uses this module if the versions match.
+ */
+const int API_VERSION = 1;
+
+/**
+ * Utility class for converting a CBOR object in a buffer to its Python
+ * representation.
+ */
+class Decoder {
+private:
+
+    /**
+     * The buffer being decoded.
+     */
+    const uint8_t *data;
+
+    /**
+     * Size of the buffer in bytes.
+     */
+    size_t size;
+
+    /**
+     * Offset of the next byte to be read.
+     */
+    size_t offset = 0;
+
+    /**
+     * Raises a ValueError with the given message. Always returns false, such
+     * that it can be used as a return value.
+     */
+    static bool fail(const char *message) {
+        PyErr_SetString(PyExc_ValueError, message);
+        return false;
+    }
+
+    /**
+     * Checks that the given number of bytes are available.
+     */
+    bool require(uint64_t count) const {
+        if (count > size - offset) {
+            return fail("invalid CBOR: unexpected end of data");
+        }
+        return true;
+    }
+
+    /**
+     * Reads a byte.
+     */
+    bool read_byte(uint8_t &byte) {
+        if (!require(1)) {
+            return false;
+        }
+        byte = data[offset++];
+        return true;
+    }
+
+    /**
+     * Reads the given number of bytes as a big-endian integer.
+     */
+    bool read_big_endian(unsigned count, uint64_t &value) {
+        if (!require(count)) {
+            return false;
+        }
+        value = 0;
+        for (unsigned i = 0; i < count; i++) {
+            value = (value << 8u) | data[offset++];
+        }
+        return true;
+    }
+
+    /**
+     * Parses the additional information and reads any additional bytes it
+     * specifies the existence of, and returns the encoded integer. offset
+     * should point to the byte immediately following the initial byte.
+     */
+    bool read_intlike(uint8_t info, uint64_t &value) {
+        if (info < 24u) {
+            value = info;
+            return true;
+        }
+        if (info < 28u) {
+            return read_big_endian(1u << (info - 24u), value);
+        }
+        return fail("invalid CBOR: illegal additional info for integer or object length");
+    }
+
+    /**
+     * Reads a byte string (major 2) or UTF-8 string (major 3) given the
+     * additional info of its initial byte.
+     */
+    PyObject *read_string(uint8_t major, uint8_t info) {
+        const char *contents;
+        size_t length;
+        std::string buffer;
+        if (info == 31) {
+
+            // Handle indefinite length strings. These consist of a
+            // break-terminated (0xFF) list of definite-length strings of the
+            // same type.
+            while (true) {
+                uint8_t sub_initial;
+                if (!read_byte(sub_initial)) {
+                    return nullptr;
+                }
+                if (sub_initial == 0xFF) {
+                    break;
+                }
+                if ((sub_initial >> 5u) != major) {
+                    fail("invalid CBOR: illegal indefinite-length string component");
+                    return nullptr;
+                }
+                uint64_t sub_length;
+                if (!read_intlike(sub_initial & 0x1Fu, sub_length) || !require(sub_length)) {
+                    return nullptr;
+                }
+                buffer.append(reinterpret_cast<const char*>(data + offset), sub_length);
+                offset += sub_length;
+            }
+            contents = buffer.data();
+            length = buffer.size();
+
+        } else {
+
+            // Handle definite-length strings.
+            uint64_t definite_length;
+            if (!read_intlike(info, definite_length) || !require(definite_length)) {
+                return nullptr;
+            }
+            contents = reinterpret_cast<const char*>(data + offset);
+            length = definite_length;
+            offset += length;
+
+        }
+        if (major == 3) {
+            return PyUnicode_DecodeUTF8(contents, length, "strict");
+        }
+        return PyBytes_FromStringAndSize(contents, length);
+    }
+
+    /**
+     * Reads an item of an array (major 4) or a key-value pair of a map
+     * (major 5) and adds it to the given container.
+     */
+    bool read_item(uint8_t major, PyObject *container) {
+        PyObject *value = nullptr;
+        if (major == 4) {
+            value = read();
+            if (!value) {
+                return false;
+            }
+            int result = PyList_Append(container, value);
+            Py_DECREF(value);
+            return result == 0;
+        }
+        PyObject *key = read();
+        if (!key) {
+            return false;
+        }
+        if (!PyUnicode_CheckExact(key)) {
+            Py_DECREF(key);
+            return fail("invalid CBOR: map key is not a UTF-8 string");
+        }
+
+        // Keys like @t and @i are repeated for every node, so intern them to
+        // avoid storing a copy for each.
+        PyUnicode_InternInPlace(&key);
+        value = read();
+        if (!value) {
+            Py_DECREF(key);
+            return false;
+        }
+        int result = PyDict_SetItem(container, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        return result == 0;
+    }
+
+    /**
+     * Reads an array (major 4) or map (major 5) given the additional info of
+     * its initial byte.
+     */
+    PyObject *read_container(uint8_t major, uint8_t info) {
+        PyObject *container = major == 4 ? PyList_New(0) : PyDict_New();
+        if (!container) {
+            return nullptr;
+        }
+        bool ok = true;
+        if (info == 31) {
+
+            // Handle indefinite length arrays and maps.
+            while (ok) {
+                if (!require(1)) {
+                    ok = false;
+                } else if (data[offset] == 0xFF) {
+                    offset++;
+                    break;
+                } else {
+                    ok = read_item(major, container);
+                }
+            }
+
+        } else {
+
+            // Handle definite-length arrays and maps. The amount of
+            // objects/object pairs is encoded as an integer.
+            uint64_t count;
+            ok = read_intlike(info, count);
+            while (ok && count--) {
+                ok = read_item(major, container);
+            }
+
+        }
+        if (!ok) {
+            Py_DECREF(container);
+            return nullptr;
+        }
+        return container;
+    }
+
+    /**
+     * Reads a value of major type 7 given its additional info.
+     */
+    PyObject *read_simple(uint8_t info) {
+        uint64_t bits;
+        switch (info) {
+            case 20:
+                Py_RETURN_FALSE;
+            case 21:
+                Py_RETURN_TRUE;
+            case 22:
+                Py_RETURN_NONE;
+            case 23:
+                fail("invalid CBOR: undefined value is not supported");
+                return nullptr;
+            case 25: {
+
+                // Half precision; decode manually, since C++ has no such type.
+                if (!read_big_endian(2, bits)) {
+                    return nullptr;
+                }
+                int exponent = (bits >> 10u) & 0x1Fu;
+                int mantissa = bits & 0x3FFu;
+                double value;
+                if (exponent == 0) {
+                    value = std::ldexp(mantissa, -24);
+                } else if (exponent != 31) {
+                    value = std::ldexp(mantissa + 1024, exponent - 25);
+                } else if (mantissa == 0) {
+                    value = std::numeric_limits<double>::infinity();
+                } else {
+                    value = std::numeric_limits<double>::quiet_NaN();
+                }
+                return PyFloat_FromDouble((bits & 0x8000u) ? -value : value);
+
+            }
+            case 26: {
+                if (!read_big_endian(4, bits)) {
+                    return nullptr;
+                }
+                uint32_t bits32 = static_cast<uint32_t>(bits);
+                float value;
+                std::memcpy(&value, &bits32, sizeof(value));
+                return PyFloat_FromDouble(value);
+            }
+            case 27: {
+                if (!read_big_endian(8, bits)) {
+                    return nullptr;
+                }
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return PyFloat_FromDouble(value);
+            }
+            case 31:
+                fail("invalid CBOR: unexpected break");
+                return nullptr;
+            default:
+                fail("invalid CBOR: unknown type code");
+                return nullptr;
+        }
+    }
+
+public:
+
+    /**
+     * Constructs a decoder for the given buffer.
+     */
+    Decoder(const uint8_t *data, size_t size) : data(data), size(size) {
+    }
+
+    /**
+     * Returns the offset of the next byte to be read.
+     */
+    size_t position() const {
+        return offset;
+    }
+
+    /**
+     * Converts the CBOR object at the current offset to its Python
+     * representation and seeks past it. Returns a new reference, or nullptr
+     * with a Python exception set on failure.
+     */
+    PyObject *read() {
+        uint8_t initial;
+        if (!read_byte(initial)) {
+            return nullptr;
+        }
+        uint8_t major = initial >> 5u;
+        uint8_t info = initial & 0x1Fu;
+        uint64_t value;
+
+        // We don't use semantic tags for anything, but ignoring them is legal
+        // and reading past them is easy enough.
+        while (major == 6) {
+            if (!read_intlike(info, value) || !read_byte(initial)) {
+                return nullptr;
+            }
+            major = initial >> 5u;
+            info = initial & 0x1Fu;
+        }
+        switch (major) {
+            case 0:
+                if (!read_intlike(info, value)) {
+                    return nullptr;
+                }
+                return PyLong_FromUnsignedLongLong(value);
+            case 1: {
+                if (!read_intlike(info, value)) {
+                    return nullptr;
+                }
+                if (value <= (uint64_t)std::numeric_limits<int64_t>::max()) {
+                    return PyLong_FromLongLong(-1 - (int64_t)value);
+                }
+                PyObject *positive = PyLong_FromUnsignedLongLong(value);
+                if (!positive) {
+                    return nullptr;
+                }
+                PyObject *result = PyNumber_Invert(positive);
+                Py_DECREF(positive);
+                return result;
+            }
+            case 2:
+            case 3:
+                return read_string(major, info);
+            case 4:
+            case 5: {
+                if (Py_EnterRecursiveCall(" while decoding CBOR")) {
+                    return nullptr;
+                }
+                PyObject *result = read_container(major, info);
+                Py_LeaveRecursiveCall();
+                return result;
+            }
+            default:
+                return read_simple(info);
+        }
+    }
+
+};
+
+/**
+ * Utility class for converting a Python object to CBOR.
+ */
+class Encoder {
+private:
+
+    /**
+     * The CBOR data written so far.
+     */
+    std::string output;
+
+    /**
+     * The type of bytes objects that represent CBOR already, and are thus
+     * copied into the output as is, or nullptr if there is no such type.
+     */
+    PyTypeObject *raw_type;
+
+    /**
+     * Raises an exception of the given type with the given message. Always
+     * returns false, such that it can be used as a return value.
+     */
+    static bool fail(PyObject *type, const char *message) {
+        PyErr_SetString(type, message);
+        return false;
+    }
+
+    /**
+     * Writes the minimal representation of the given integer with the given
+     * major code.
+     */
+    void write_intlike(uint64_t value, uint8_t major) {
+        uint8_t initial = major << 5u;
+        unsigned count;
+        if (value < 24u) {
+            output.push_back((char)(initial | value));
+            return;
+        } else if (value < 0x100ull) {
+            initial |= 24u;
+            count = 1;
+        } else if (value < 0x10000ull) {
+            initial |= 25u;
+            count = 2;
+        } else if (value < 0x100000000ull) {
+            initial |= 26u;
+            count = 4;
+        } else {
+            initial |= 27u;
+            count = 8;
+        }
+        output.push_back((char)initial);
+        while (count--) {
+            output.push_back((char)(value >> (count * 8u)));
+        }
+    }
+
+    /**
+     * Writes the given Python integer, which may not fit in 64 bits.
+     */
+    bool write_int(PyObject *value) {
+        int overflow;
+        long long small = PyLong_AsLongLongAndOverflow(value, &overflow);
+        if (!overflow) {
+            if (small == -1 && PyErr_Occurred()) {
+                return false;
+            }
+            if (small < 0) {
+                write_intlike((uint64_t)(-1 - small), 1);
+            } else {
+                write_intlike((uint64_t)small, 0);
+            }
+            return true;
+        }
+
+        // For negative integers, CBOR stores -1 - value, which is the bitwise
+        // inverse.
+        PyObject *magnitude = value;
+        if (overflow < 0) {
+            magnitude = PyNumber_Invert(value);
+            if (!magnitude) {
+                return false;
+            }
+        } else {
+            Py_INCREF(magnitude);
+        }
+        unsigned long long large = PyLong_AsUnsignedLongLong(magnitude);
+        Py_DECREF(magnitude);
+        if (PyErr_Occurred()) {
+            PyErr_Clear();
+            return fail(PyExc_ValueError, "integer too large for CBOR (bigint not supported)");
+        }
+        write_intlike(large, overflow < 0 ? 1 : 0);
+        return true;
+    }
+
+    /**
+     * Writes the given string with the given major code.
+     */
+    void write_string(const char *contents, size_t length, uint8_t major) {
+        write_intlike(length, major);
+        output.append(contents, length);
+    }
+
+    /**
+     * Writes the given Unicode string.
+     */
+    bool write_unicode(PyObject *value) {
+        Py_ssize_t length;
+        const char *contents = PyUnicode_AsUTF8AndSize(value, &length);
+        if (!contents) {
+            return false;
+        }
+        write_string(contents, length, 3);
+        return true;
+    }
+
+    /**
+     * Writes the given list or tuple.
+     */
+    bool write_sequence(PyObject *value, PyObject *type_converter) {
+        PyObject *items = PySequence_Fast(value, "expected a list or tuple");
+        if (!items) {
+            return false;
+        }
+        Py_ssize_t count = PySequence_Fast_GET_SIZE(items);
+        write_intlike(count, 4);
+        bool ok = true;
+        for (Py_ssize_t i = 0; ok && i < count; i++) {
+            ok = write(PySequence_Fast_GET_ITEM(items, i), type_converter);
+        }
+        Py_DECREF(items);
+        return ok;
+    }
+
+    /**
+     * Writes the given dict, sorted by key.
+     */
+    bool write_dict(PyObject *value, PyObject *type_converter) {
+        PyObject *items = PyDict_Items(value);
+        if (!items) {
+            return false;
+        }
+        Py_ssize_t count = PyList_GET_SIZE(items);
+        std::vector<std::pair<std::string, PyObject*>> entries;
+        entries.reserve(count);
+        bool ok = true;
+        for (Py_ssize_t i = 0; ok && i < count; i++) {
+            PyObject *item = PyList_GET_ITEM(items, i);
+            PyObject *key = PyTuple_GET_ITEM(item, 0);
+            if (!PyUnicode_Check(key)) {
+                ok = fail(PyExc_TypeError, "dict keys must be strings");
+                break;
+            }
+            Py_ssize_t length;
+            const char *contents = PyUnicode_AsUTF8AndSize(key, &length);
+            if (!contents) {
+                ok = false;
+                break;
+            }
+            entries.emplace_back(std::string(contents, length), PyTuple_GET_ITEM(item, 1));
+        }
+        if (ok) {
+
+            // Python sorts strings by code point, which is the same as
+            // sorting their UTF-8 encodings bytewise.
+            std::sort(
+                entries.begin(), entries.end(),
+                [](const std::pair<std::string, PyObject*> &lhs, const std::pair<std::string, PyObject*> &rhs) {
+                    return lhs.first < rhs.first;
+                }
+            );
+            write_intlike(count, 5);
+            for (const auto &entry : entries) {
+                write_string(entry.first.data(), entry.first.size(), 3);
+                if (!write(entry.second, type_converter)) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        Py_DECREF(items);
+        return ok;
+    }
+
+public:
+
+    /**
+     * Constructs an encoder. Bytes objects of the given type, if any, are
+     * copied into the output as is.
+     */
+    explicit Encoder(PyTypeObject *raw_type) : raw_type(raw_type) {
+    }
+
+    /**
+     * Returns the CBOR data written so far.
+     */
+    const std::string &get() const {
+        return output;
+    }
+
+    /**
+     * Converts the given Python object to CBOR. If the type of the object is
+     * not supported and type_converter is not null or None, it is called to
+     * convert the object into something that is supported. Returns false with
+     * a Python exception set on failure.
+     */
+    bool write(PyObject *value, PyObject *type_converter) {
+        if (raw_type && PyObject_TypeCheck(value, raw_type) && PyBytes_Check(value)) {
+            output.append(PyBytes_AS_STRING(value), PyBytes_GET_SIZE(value));
+            return true;
+        }
+
+        // Note that this includes bools, which the generated Python code
+        // also writes as integers.
+        if (PyLong_Check(value)) {
+            return write_int(value);
+        }
+        if (PyFloat_Check(value)) {
+            double number = PyFloat_AS_DOUBLE(value);
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            output.push_back((char)0xFB);
+            for (unsigned count = 8; count--;) {
+                output.push_back((char)(bits >> (count * 8u)));
+            }
+            return true;
+        }
+        if (PyUnicode_Check(value)) {
+            return write_unicode(value);
+        }
+        if (PyBytes_Check(value)) {
+            write_string(PyBytes_AS_STRING(value), PyBytes_GET_SIZE(value), 2);
+            return true;
+        }
+        if (value == Py_None) {
+            output.push_back((char)0xF6);
+            return true;
+        }
+        if (PyList_Check(value) || PyTuple_Check(value) || PyDict_Check(value)) {
+            if (Py_EnterRecursiveCall(" while encoding CBOR")) {
+                return false;
+            }
+            bool ok;
+            if (PyDict_Check(value)) {
+                ok = write_dict(value, type_converter);
+            } else {
+                ok = write_sequence(value, type_converter);
+            }
+            Py_LeaveRecursiveCall();
+            return ok;
+        }
+        if (type_converter && type_converter != Py_None) {
+            PyObject *converted = PyObject_CallFunctionObjArgs(type_converter, value, nullptr);
+            if (!converted) {
+                return false;
+            }
+            bool ok = write(converted, nullptr);
+            Py_DECREF(converted);
+            return ok;
+        }
+        PyErr_Format(PyExc_TypeError, "unsupported type for conversion to cbor: %R", value);
+        return false;
+    }
+
+};
+
+/**
+ * Implementation of loads().
+ */
+PyObject *loads(PyObject*, PyObject *arg) {
+    Py_buffer buffer;
+    if (PyObject_GetBuffer(arg, &buffer, PyBUF_SIMPLE) < 0) {
+        return nullptr;
+    }
+    Decoder decoder{static_cast<const uint8_t*>(buffer.buf), (size_t)buffer.len};
+    PyObject *result = decoder.read();
+    if (result && decoder.position() < (size_t)buffer.len) {
+        Py_DECREF(result);
+        result = nullptr;
+        PyErr_SetString(PyExc_ValueError, "invalid CBOR: garbage at the end");
+    }
+    PyBuffer_Release(&buffer);
+    return result;
+}
+
+/**
+ * Implementation of dumps().
+ */
+PyObject *dumps(PyObject*, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"value", "raw_type", "type_converter", nullptr};
+    PyObject *value;
+    PyObject *raw_type = Py_None;
+    PyObject *type_converter = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(
+        args, kwargs, "O|OO:dumps", const_cast<char**>(keywords),
+        &value, &raw_type, &type_converter
+    )) {
+        return nullptr;
+    }
+    if (raw_type != Py_None && !PyType_Check(raw_type)) {
+        PyErr_SetString(PyExc_TypeError, "raw_type must be a type or None");
+        return nullptr;
+    }
+    Encoder encoder{raw_type == Py_None ? nullptr : (PyTypeObject*)raw_type};
+    if (!encoder.write(value, type_converter)) {
+        return nullptr;
+    }
+    return PyBytes_FromStringAndSize(encoder.get().data(), encoder.get().size());
+}
+
+/**
+ * Method table of the module.
+ */
+PyMethodDef methods[] = {
+    {
+        "loads", (PyCFunction)loads, METH_O,
+        "loads(data)\n--\n\n"
+        "Converts the given CBOR object (a bytes-like object) to its Python\n"
+        "representation. Equivalent to _cbor_to_py() in generated modules."
+    },
+    {
+        "dumps", (PyCFunction)(void(*)(void))dumps, METH_VARARGS | METH_KEYWORDS,
+        "dumps(value, raw_type=None, type_converter=None)\n--\n\n"
+        "Converts the given Python object to CBOR and returns it as bytes.\n"
+        "Instances of raw_type (a bytes subclass) are copied as is.\n"
+        "Equivalent to _py_to_cbor() in generated modules."
+    },
+    {nullptr, nullptr, 0, nullptr}
+};
+
+/**
+ * Module definition.
+ */
+PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    "tree_gen_cbor",
+    "Native CBOR conversion functions for Python modules generated by tree-gen.",
+    -1,
+    methods,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+} // anonymous namespace
+
+/**
+ * Module initialization function.
+ */
+PyMODINIT_FUNC PyInit_tree_gen_cbor() {
+    PyObject *result = PyModule_Create(&module);
+    if (result && PyModule_AddIntConstant(result, "API_VERSION", API_VERSION) < 0) {
+        Py_DECREF(result);
+        return nullptr;
+    }
+    return result;
+}
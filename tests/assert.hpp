@@ -60,3 +60,23 @@
         }                                                       \
     } while (0)
 
+
+/**
+ * Check whether the given statement throws the given exception type, printing
+ * an error on failure.
+ */
+#define CHECK_RAISES(exc, statement)                            \
+    do {                                                        \
+        bool raised = false;                                    \
+        try {                                                   \
+            statement;                                          \
+        } catch (exc &) {                                       \
+            raised = true;                                      \
+        }                                                       \
+        if (!raised) {                                          \
+            std::cerr << "Check failed at "                     \
+                      << __FILE__ << ":" << __LINE__ << ": "    \
+                      << #statement << " did not raise "        \
+                      << #exc << std::endl;                     \
+        }                                                       \
+    } while (0)
@@ -0,0 +1,38 @@
+/** \file
+ * Defines the primitive functions for the test trees.
+ */
+
+#pragma once
+
+#include "tree-cbor.hpp"
+
+/**
+ * Namespace for the primitive functions of the test trees.
+ */
+namespace primitives {
+
+/**
+ * Initialization function. The test trees only have edges, which are
+ * default-constructed.
+ */
+template <class T>
+T initialize() { return T(); };
+
+/**
+ * Serialization function. The test trees have no primitives, so this doesn't
+ * do anything.
+ */
+template <typename T>
+void serialize(const T &, tree::cbor::MapWriter &) {
+}
+
+/**
+ * Deserialization function. The test trees have no primitives, so this just
+ * returns the initial value.
+ */
+template <typename T>
+T deserialize(const tree::cbor::MapReader &) {
+    return initialize<T>();
+}
+
+} // namespace primitives
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include "tree-attribute.hpp"
+#include "assert.hpp"
+
+using tree::attribute::Attribute;
+using tree::attribute::Evaluator;
+
+/**
+ * Minimal node type with an integer value, owned children, and a link back to
+ * the parent.
+ */
+struct Expr : public tree::annotatable::Annotatable {
+    int value = 0;
+    std::vector<std::shared_ptr<Expr>> children;
+    Expr *parent = nullptr;
+
+    std::shared_ptr<Expr> add(int child_value) {
+        auto child = std::make_shared<Expr>();
+        child->value = child_value;
+        child->parent = this;
+        children.push_back(child);
+        return child;
+    }
+};
+
+// Synthesized attribute: the sum of the values in a subtree.
+Attribute<Expr, int> sum{"sum", [](Expr &node, Evaluator &eval) {
+    int result = node.value;
+    for (auto &child : node.children) {
+        result += eval.get(sum, *child);
+    }
+    return result;
+}};
+
+// Inherited attribute: the depth of a node, computed through the parent link.
+Attribute<Expr, int> depth{"depth", [](Expr &node, Evaluator &eval) {
+    return node.parent ? eval.get(depth, *node.parent) + 1 : 0;
+}};
+
+// Attribute that reads the values of its children directly.
+Attribute<Expr, int> max_child{"max_child", [](Expr &node, Evaluator &eval) {
+    int result = 0;
+    for (auto &child : node.children) {
+        eval.depends_on(*child);
+        result = std::max(result, child->value);
+    }
+    return result;
+}};
+
+// Attribute that depends on itself.
+Attribute<Expr, int> cyclic{"cyclic", [](Expr &node, Evaluator &eval) {
+    return eval.get(cyclic, node);
+}};
+
+int main() {
+
+    // Build the tree
+    //   root(1)
+    //     a(2)
+    //       c(4)
+    //       d(5)
+    //     b(3)
+    auto root = std::make_shared<Expr>();
+    root->value = 1;
+    auto a = root->add(2);
+    auto b = root->add(3);
+    auto c = a->add(4);
+    auto d = a->add(5);
+
+    // Attributes are evaluated once and then cached.
+    Evaluator eval;
+    CHECK_EQ(eval.get(sum, *root), 15);
+    CHECK_EQ(eval.evaluations(), 5u);
+    CHECK_EQ(eval.get(sum, *root), 15);
+    CHECK_EQ(eval.get(sum, *a), 11);
+    CHECK_EQ(eval.evaluations(), 5u);
+    CHECK(eval.is_cached(sum, *d));
+    CHECK(!eval.is_cached(depth, *d));
+
+    // Changing a leaf only invalidates the attributes along the path to the
+    // root.
+    c->value = 10;
+    eval.changed(*c);
+    CHECK(!eval.is_cached(sum, *c));
+    CHECK(!eval.is_cached(sum, *a));
+    CHECK(!eval.is_cached(sum, *root));
+    CHECK(eval.is_cached(sum, *b));
+    CHECK(eval.is_cached(sum, *d));
+    CHECK_EQ(eval.get(sum, *root), 21);
+    CHECK_EQ(eval.evaluations(), 8u);
+
+    // Inherited attributes work through the parent link, and are invalidated
+    // when an ancestor changes.
+    CHECK_EQ(eval.get(depth, *d), 2);
+    CHECK_EQ(eval.get(depth, *b), 1);
+    CHECK(eval.is_cached(depth, *root));
+    eval.changed(*root);
+    CHECK(!eval.is_cached(depth, *d));
+    CHECK(!eval.is_cached(depth, *b));
+    CHECK(eval.is_cached(sum, *a));
+
+    // Explicitly declared dependencies on other nodes.
+    CHECK_EQ(eval.get(max_child, *a), 10);
+    d->value = 20;
+    eval.changed(*d);
+    CHECK_EQ(eval.get(max_child, *a), 20);
+    CHECK(!eval.is_cached(sum, *root));
+
+    // Cycles are detected.
+    CHECK_RAISES(std::runtime_error, eval.get(cyclic, *root));
+
+    // Cached attributes are not shared with copies.
+    Expr copy{};
+    copy.copy_annotations(*a);
+    copy.value = 100;
+    CHECK(!eval.is_cached(sum, copy));
+    CHECK_EQ(eval.get(sum, copy), 100);
+    CHECK_EQ(eval.get(sum, *a), 32);
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "tree-base.hpp"
+#include "assert.hpp"
+
+using tree::base::BatchOptions;
+
+/**
+ * Minimal hand-written node type, providing what process_stream() needs of
+ * a generated one.
+ */
+class Leaf : public tree::base::Base {
+public:
+    static constexpr bool MAY_CONTAIN_LINKS = false;
+
+    int64_t value = 0;
+    std::string padding;
+
+    bool is_shared() const {
+        return false;
+    }
+
+    void serialize(tree::cbor::MapWriter &map, const tree::base::PointerMap &ids) const {
+        (void)ids;
+        map.append_string("@t", "Leaf");
+        map.append_int("value", value);
+        map.append_string("padding", padding);
+    }
+
+    static std::shared_ptr<Leaf> deserialize(
+        const tree::cbor::MapReader &map,
+        tree::base::IdentifierMap &ids
+    ) {
+        (void)ids;
+        if (map.at("@t").as_string() != "Leaf") {
+            throw std::runtime_error("Schema validation failed: unexpected node type");
+        }
+        auto leaf = std::make_shared<Leaf>();
+        leaf->value = map.at("value").as_int();
+        leaf->padding = map.at("padding").as_string();
+        return leaf;
+    }
+
+    static uint64_t schema_fingerprint() {
+        return 1;
+    }
+
+    static const std::string &compression_dictionary() {
+        static const std::string dictionary{};
+        return dictionary;
+    }
+
+};
+
+/**
+ * Serializes a leaf with the given value and amount of padding.
+ */
+static std::string make_input(int64_t value, size_t padding) {
+    auto leaf = tree::base::make<Leaf>();
+    leaf->value = value;
+    leaf->padding = std::string(padding, 'x');
+    return tree::base::serialize<Leaf>(leaf);
+}
+
+/**
+ * Returns the value of the given serialized leaf.
+ */
+static int64_t get_value(const std::string &data) {
+    return tree::base::deserialize<Leaf>(data)->value;
+}
+
+int main() {
+    BatchOptions options{};
+    options.threads = 4;
+
+    // All inputs end up at the right index.
+    std::vector<std::string> inputs;
+    for (int64_t i = 0; i < 100; i++) {
+        inputs.push_back(make_input(i, 10));
+    }
+    auto outputs = tree::base::process_batch<Leaf>(inputs, [](tree::base::Maybe<Leaf> &leaf) {
+        leaf->value *= 2;
+    }, options);
+    ASSERT_EQ(outputs.size(), inputs.size());
+    for (size_t i = 0; i < outputs.size(); i++) {
+        CHECK_EQ(get_value(outputs[i]), (int64_t)(2 * i));
+    }
+
+    // The total size of the inputs being processed stays within the limit,
+    // except for an oversized input, which is processed on its own.
+    inputs.clear();
+    for (int64_t i = 0; i < 40; i++) {
+        inputs.push_back(make_input(i, i == 20 ? 1000 : 100));
+    }
+    size_t small_size = inputs[0].size();
+    options.max_bytes_in_flight = 2 * small_size + small_size / 2;
+    std::mutex mutex;
+    size_t in_flight = 0;
+    size_t max_in_flight = 0;
+    size_t in_flight_with_large = 0;
+    auto count_concurrency = [&](tree::base::Maybe<Leaf> &leaf) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight++;
+            max_in_flight = std::max(max_in_flight, in_flight);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::lock_guard<std::mutex> lock(mutex);
+        if (leaf->value == 20) {
+            in_flight_with_large = in_flight;
+        }
+        in_flight--;
+    };
+    outputs = tree::base::process_batch<Leaf>(inputs, count_concurrency, options);
+    for (size_t i = 0; i < outputs.size(); i++) {
+        CHECK_EQ(get_value(outputs[i]), (int64_t)i);
+    }
+    CHECK(max_in_flight <= 2);
+    CHECK_EQ(in_flight_with_large, 1u);
+    options.max_bytes_in_flight = 0;
+
+    // Exceptions thrown by the source, transform, or sink are rethrown once
+    // the workers finish, and stop further inputs from being fetched.
+    size_t fetched = 0;
+    auto failing_source = [&](std::string &data) {
+        if (fetched == 10) {
+            throw std::runtime_error("source failed");
+        }
+        data = make_input(fetched++, 10);
+        return true;
+    };
+    auto ignore = [](size_t index, const std::string &data) {
+        (void)index;
+        (void)data;
+    };
+    auto identity = [](tree::base::Maybe<Leaf> &leaf) {
+        (void)leaf;
+    };
+    CHECK_RAISES(std::runtime_error, tree::base::process_stream<Leaf>(
+        failing_source, identity, ignore, options));
+    CHECK_EQ(fetched, 10u);
+
+    fetched = 0;
+    auto endless_source = [&](std::string &data) {
+        data = make_input(fetched++, 10);
+        return true;
+    };
+    auto failing_transform = [](tree::base::Maybe<Leaf> &leaf) {
+        if (leaf->value == 5) {
+            throw std::runtime_error("transform failed");
+        }
+    };
+    CHECK_RAISES(std::runtime_error, tree::base::process_stream<Leaf>(
+        endless_source, failing_transform, ignore, options));
+    CHECK(fetched < 100);
+
+    fetched = 0;
+    auto failing_sink = [](size_t index, const std::string &data) {
+        (void)data;
+        if (index == 5) {
+            throw std::runtime_error("sink failed");
+        }
+    };
+    CHECK_RAISES(std::runtime_error, tree::base::process_stream<Leaf>(
+        endless_source, identity, failing_sink, options));
+    CHECK(fetched < 100);
+
+    // Bad input data is reported the same way.
+    inputs = {make_input(0, 10), "not a tree"};
+    CHECK_RAISES(std::runtime_error, tree::base::process_batch<Leaf>(inputs, identity, options));
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
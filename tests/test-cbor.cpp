@@ -1,5 +1,7 @@
 #include <sstream>
 #include <cstdio>
+#include <cmath>
+#include <limits>
 #include "tree-cbor.hpp"
 #include "assert.hpp"
 
@@ -155,6 +157,44 @@ int main() {
     CHECK_EQ(map2.at("string").as_string(), "hello");
     CHECK_EQ(map2.at("binary").as_binary(), "world");
 
+    // Test the canonical encoding of floats, which uses the shortest exact
+    // encoding.
+    std::ostringstream ss3{};
+    auto writer3 = tree::cbor::Writer(ss3, true);
+    CHECK(writer3.is_canonical());
+    auto outer3 = writer3.start();
+    auto floats = outer3.append_array("f");
+    floats.append_float(1.5);
+    floats.append_float(-0.0);
+    floats.append_float(65504.0);
+    floats.append_float(1.0 / 3.0);
+    floats.append_float(0.1f);
+    floats.append_float(std::numeric_limits<double>::infinity());
+    floats.append_float(std::numeric_limits<double>::quiet_NaN());
+    floats.append_float(5.960464477539063e-8);
+    floats.close();
+    outer3.close();
+    std::string encoded3 = ss3.str();
+    std::string expected3 = std::string("\xBF\x61\x66\x9F", 4)
+        + std::string("\xF9\x3E\x00", 3)
+        + std::string("\xF9\x80\x00", 3)
+        + std::string("\xF9\x7B\xFF", 3)
+        + std::string("\xFB\x3F\xD5\x55\x55\x55\x55\x55\x55", 9)
+        + std::string("\xFA\x3D\xCC\xCC\xCD", 5)
+        + std::string("\xF9\x7C\x00", 3)
+        + std::string("\xF9\x7E\x00", 3)
+        + std::string("\xF9\x00\x01\xFF\xFF", 5);
+    CHECK_EQ(encoded3, expected3);
+    auto ar5 = tree::cbor::Reader(encoded3).as_map().at("f").as_array();
+    CHECK_EQ(ar5.at(0).as_float(), 1.5);
+    CHECK(std::signbit(ar5.at(1).as_float()));
+    CHECK_EQ(ar5.at(2).as_float(), 65504.0);
+    CHECK_EQ(ar5.at(3).as_float(), 1.0 / 3.0);
+    CHECK_EQ(ar5.at(4).as_float(), static_cast<double>(0.1f));
+    CHECK_EQ(ar5.at(5).as_float(), std::numeric_limits<double>::infinity());
+    CHECK(std::isnan(ar5.at(6).as_float()));
+    CHECK_EQ(ar5.at(7).as_float(), 5.960464477539063e-8);
+
     std::cout << "Test passed" << std::endl;
     return 0;
 }
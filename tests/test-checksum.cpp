@@ -0,0 +1,69 @@
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include "tree-checksum.hpp"
+#include "assert.hpp"
+
+using namespace tree::checksum;
+
+int main() {
+
+    // Check against known test vectors.
+    CHECK_EQ(crc32c(""), 0u);
+    CHECK_EQ(crc32c("123456789"), 0xE3069283u);
+    CHECK_EQ(crc32c(std::string(32, '\0')), 0x8A9136AAu);
+    CHECK_EQ(crc32c(std::string(32, '\xFF')), 0x62A8AB43u);
+    std::cout << "hardware acceleration: " << is_hardware_accelerated() << std::endl;
+
+    // Incremental computation should give the same result for all splits,
+    // exercising both the word-wise and byte-wise code paths.
+    std::string data;
+    for (int i = 0; i < 1000; i++) {
+        data.push_back(static_cast<char>(i * 7 + (i >> 3)));
+    }
+    auto expected = crc32c(data);
+    for (size_t split = 0; split < 20; split++) {
+        auto crc = crc32c(data.data(), split);
+        CHECK_EQ(crc32c(data.data() + split, data.size() - split, crc), expected);
+    }
+
+    // Test integrity frames.
+    auto frame = wrap(data, 0x0123456789ABCDEFull, true);
+    CHECK(is_checked(frame));
+    CHECK(!is_checked(data));
+    auto envelope = unwrap(frame);
+    CHECK_EQ(envelope.payload, data);
+    CHECK_EQ(envelope.fingerprint, 0x0123456789ABCDEFull);
+    CHECK(envelope.validated);
+    CHECK(!unwrap(wrap("", 0, false)).validated);
+    CHECK_EQ(unwrap(wrap("", 0, false)).payload, "");
+
+    // Every single-bit error should be detected.
+    for (size_t i = 4; i < frame.size(); i += 13) {
+        auto corrupt = frame;
+        corrupt[i] ^= static_cast<char>(1 << (i % 8));
+        CHECK_RAISES(std::runtime_error, unwrap(corrupt));
+    }
+    CHECK_RAISES(std::runtime_error, unwrap(frame.substr(0, frame.size() - 1)));
+    CHECK_RAISES(std::runtime_error, unwrap(frame + "x"));
+    CHECK_RAISES(std::runtime_error, unwrap(frame.substr(0, 10)));
+    CHECK_RAISES(std::runtime_error, unwrap(data));
+
+    // Test SHA-256 against the FIPS 180-2 test vectors, including one that
+    // is added in pieces that straddle block boundaries.
+    CHECK_EQ(to_hex(sha256("")), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK_EQ(to_hex(sha256("abc")), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK_EQ(
+        to_hex(sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")),
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+    );
+    Sha256 hash;
+    std::string million_a(1000000, 'a');
+    for (size_t i = 0; i < million_a.size(); i += 997) {
+        hash.update(million_a.data() + i, std::min<size_t>(997, million_a.size() - i));
+    }
+    CHECK_EQ(to_hex(hash.digest()), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
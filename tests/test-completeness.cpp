@@ -0,0 +1,112 @@
+#include <iostream>
+#include <sstream>
+#include "completeness.hpp"
+#include "assert.hpp"
+
+using namespace completeness;
+using tree::base::make;
+
+/**
+ * Returns the CBOR serialization of a root node whose list has no entries in
+ * its One and Many edges, which serialize() would refuse to write.
+ */
+std::string make_incomplete_cbor() {
+    std::ostringstream stream{};
+    tree::cbor::Writer writer{stream};
+    auto map = writer.start();
+    map.append_string("@T", "?");
+    map.append_int("@i", 0);
+    map.append_string("@t", "Root");
+    auto list = map.append_map("list");
+    list.append_string("@T", "1");
+    list.append_int("@i", 1);
+    list.append_string("@t", "List");
+    auto edge = list.append_map("first");
+    edge.append_string("@T", "1");
+    edge.append_null("@t");
+    edge.close();
+    edge = list.append_map("items");
+    edge.append_string("@T", "*");
+    edge.append_array("@d").close();
+    edge.close();
+    edge = list.append_map("more");
+    edge.append_string("@T", "+");
+    edge.append_array("@d").close();
+    edge.close();
+    edge = list.append_map("extra");
+    edge.append_string("@T", "?");
+    edge.append_null("@t");
+    edge.close();
+    list.close();
+    map.close();
+    return stream.str();
+}
+
+/**
+ * Returns a complete root node.
+ */
+One<Root> make_root() {
+    auto list = make<List>(make<Leaf>());
+    list->more.add(make<Leaf>());
+    return make<Root>(list);
+}
+
+int main() {
+
+    // A complete tree is well-formed, also when the optional edge and the Any
+    // edge are empty.
+    auto root = make_root();
+    CHECK(root.is_well_formed());
+    root->list->items.add(make<Leaf>());
+    root->list->extra = make<Leaf>();
+    CHECK(root.is_well_formed());
+
+    // The leaves can't be incomplete, so the check doesn't recurse into them,
+    // but the edges to them must still not be empty. This includes the One
+    // entries of Any and Many edges.
+    root = make_root();
+    root->list->first.reset();
+    CHECK(!root.is_well_formed());
+    CHECK_RAISES(tree::base::NotWellFormed, root->list.check_well_formed());
+
+    root = make_root();
+    root->list->items.add(make<Leaf>());
+    root->list->items.add(make<Leaf>());
+    root->list->items[1] = One<Leaf>();
+    CHECK(!root.is_well_formed());
+    CHECK_RAISES(tree::base::NotWellFormed, root->list.check_well_formed());
+
+    root = make_root();
+    root->list->more[0] = One<Leaf>();
+    CHECK(!root.is_well_formed());
+    CHECK_RAISES(tree::base::NotWellFormed, root->list.check_well_formed());
+
+    root = make_root();
+    root->list->more.reset();
+    CHECK(!root.is_well_formed());
+
+    // The tree can't contain links, so serialization numbers the nodes as it
+    // writes them rather than finding them all up front. It must still reject
+    // a node that appears more than once, but not a node that's merely
+    // referenced from outside the tree as well.
+    CHECK(!Root::MAY_CONTAIN_LINKS);
+    root = make_root();
+    auto leaf = make<Leaf>();
+    root->list->items.add(leaf);
+    auto copy = tree::base::deserialize<Root>(tree::base::serialize(root));
+    CHECK(copy.equals(root));
+    root->list->extra = leaf;
+    CHECK(!root.is_well_formed());
+    CHECK_RAISES(tree::base::NotWellFormed, tree::base::serialize(root));
+
+    // A checksum is not a signature: anyone can wrap an incomplete tree in an
+    // integrity frame that claims it was validated when written. Only
+    // deserialize_trusted() takes that claim at face value.
+    auto forged = tree::checksum::wrap(
+        make_incomplete_cbor(), Root::schema_fingerprint(), true);
+    CHECK_RAISES(tree::base::NotWellFormed, tree::base::deserialize<Root>(forged));
+    CHECK(!tree::base::deserialize_trusted<Root>(forged).is_well_formed());
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <stdexcept>
+#include "tree-compress.hpp"
+#include "assert.hpp"
+
+using namespace tree::compress;
+
+/**
+ * Returns some pseudorandom data that does not compress at all.
+ */
+std::string random_data(size_t size) {
+    std::string data;
+    uint32_t state = 12345;
+    for (size_t i = 0; i < size; i++) {
+        state = state * 1103515245u + 12345u;
+        data.push_back(static_cast<char>(state >> 24u));
+    }
+    return data;
+}
+
+/**
+ * Returns some repetitive data resembling a serialized tree.
+ */
+std::string repetitive_data(size_t count) {
+    std::ostringstream ss;
+    for (size_t i = 0; i < count; i++) {
+        ss << "\xBF" "b@Ta1b@i" << static_cast<char>(i & 0x17) << "b@tiDirectorygentries\xFF";
+    }
+    return ss.str();
+}
+
+int main() {
+
+    // Test single blocks, with and without dictionary.
+    const std::string dict = "b@Ta1b@ib@tiDirectorygentries";
+    for (const auto &data : {std::string(), std::string("a"), std::string("abcd"),
+                             repetitive_data(1), repetitive_data(100),
+                             random_data(1000), std::string(1000, 'x')}) {
+        auto block = compress_block(data.data(), data.size());
+        CHECK_EQ(decompress_block(block.data(), block.size(), data.size()), data);
+        block = compress_block(data.data(), data.size(), dict);
+        CHECK_EQ(decompress_block(block.data(), block.size(), data.size(), dict), data);
+    }
+
+    // Repetitive data should compress well, and the dictionary should help
+    // for small inputs.
+    auto data = repetitive_data(1000);
+    auto compressed = compress(data);
+    CHECK(is_compressed(compressed));
+    CHECK(!is_compressed(data));
+    CHECK(compressed.size() * 10 < data.size());
+    CHECK_EQ(decompress(compressed), data);
+    data = repetitive_data(1);
+    CHECK(compress(data, dict).size() < compress(data).size());
+    CHECK_EQ(decompress(compress(data, dict), dict), data);
+
+    // Incompressible data should be stored.
+    data = random_data(10000);
+    compressed = compress(data, "", 1024);
+    CHECK(compressed.size() < data.size() + 200);
+    CHECK_EQ(decompress(compressed), data);
+
+    // Test random access with multiple blocks.
+    data = repetitive_data(1000) + random_data(1000);
+    compressed = compress(data, dict, 1000);
+    FrameReader reader(compressed, dict);
+    CHECK_EQ(reader.get_size(), data.size());
+    CHECK_EQ(reader.get_block_size(), 1000u);
+    CHECK_EQ(reader.get_block_count(), (data.size() + 999) / 1000);
+    CHECK_EQ(reader.read_block(3), data.substr(3000, 1000));
+    CHECK_EQ(reader.read(0, 0), "");
+    CHECK_EQ(reader.read(999, 2), data.substr(999, 2));
+    CHECK_EQ(reader.read(12345, 6789), data.substr(12345, 6789));
+    CHECK_EQ(reader.read(0, data.size()), data);
+    CHECK_EQ(reader.read_all(), data);
+    CHECK_RAISES(std::out_of_range, reader.read_block(reader.get_block_count()));
+    CHECK_RAISES(std::out_of_range, reader.read(data.size(), 1));
+
+    // Test error detection.
+    CHECK_RAISES(std::runtime_error, decompress(compressed));
+    CHECK_RAISES(std::runtime_error, decompress(compressed, "wrong dictionary"));
+    CHECK_RAISES(std::runtime_error, decompress(compressed.substr(0, 20), dict));
+    CHECK_RAISES(std::runtime_error, decompress(compressed.substr(0, compressed.size() - 1), dict));
+    CHECK_RAISES(std::runtime_error, decompress(data));
+    auto block = compress_block(data.data(), 1000);
+    CHECK_RAISES(std::runtime_error, decompress_block(block.data(), block.size(), 999));
+    CHECK_RAISES(std::runtime_error, decompress_block(block.data(), block.size() - 1, 1000));
+    CHECK_RAISES(std::runtime_error, decompress_block(block.data(), block.size(), 1001));
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
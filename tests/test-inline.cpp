@@ -0,0 +1,28 @@
+#include <iostream>
+#include "inline.hpp"
+#include "assert.hpp"
+
+using namespace inline_links;
+using tree::base::make;
+
+int main() {
+
+    // The links in nodes stored inline refer to the nodes in the
+    // deserialized tree after a round trip, also when the node stored inline
+    // is itself stored inline.
+    auto root = make<Root>();
+    root->targets.add(make<Target>());
+    root->targets.add(make<Target>());
+    root->holder->ref = root->targets[0];
+    root->holder->inner->ref = root->targets[1];
+    CHECK(root.is_well_formed());
+    auto cbor = tree::base::serialize(root);
+    auto copy = tree::base::deserialize<Root>(cbor);
+    ASSERT(copy.is_well_formed());
+    CHECK(tree::base::serialize(copy) == cbor);
+    CHECK(copy->holder->ref == copy->targets[0]);
+    CHECK(copy->holder->inner->ref == copy->targets[1]);
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
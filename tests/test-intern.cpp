@@ -0,0 +1,110 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <unordered_set>
+#include <stdexcept>
+#include "tree-intern.hpp"
+#include "assert.hpp"
+
+using tree::intern::String;
+
+int main() {
+
+    // Equal strings get the same identifier, and the empty string is always
+    // identifier zero.
+    String a{"hello"};
+    String b{std::string("hel") + "lo"};
+    String c{"world"};
+    CHECK(a == b);
+    CHECK(a != c);
+    CHECK_EQ(a.id(), b.id());
+    CHECK_EQ(String().id(), 0u);
+    CHECK(String().empty());
+    CHECK(String("") == String());
+    CHECK(!a.empty());
+
+    // Interned strings can be used like regular strings.
+    CHECK(a == "hello");
+    CHECK("world" == c);
+    CHECK(a != std::string("world"));
+    CHECK_EQ(a.size(), 5u);
+    CHECK(a < c);
+    CHECK(!(c < a));
+    CHECK(!(a < b));
+    const std::string &ref = c;
+    CHECK_EQ(ref, "world");
+    std::ostringstream ss{};
+    ss << a << " " << c;
+    CHECK_EQ(ss.str(), "hello world");
+    std::unordered_set<String, String::Hash> set{a, b, c};
+    CHECK_EQ(set.size(), 2u);
+
+    // Comparing with regular strings doesn't intern them.
+    auto size = tree::intern::interner().size();
+    CHECK(a != "not interned");
+    CHECK_EQ(tree::intern::interner().size(), size);
+    CHECK_RAISES(std::out_of_range, tree::intern::interner().lookup(1000000));
+
+    // Interning is thread-safe, and the contents remain valid while other
+    // threads add strings.
+    std::vector<std::thread> threads;
+    std::vector<std::vector<String>> results(4);
+    for (size_t t = 0; t < results.size(); t++) {
+        threads.emplace_back([t, &results]() {
+            for (int i = 0; i < 2000; i++) {
+                results[t].emplace_back("string " + std::to_string(i));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (size_t t = 1; t < results.size(); t++) {
+        CHECK(results[t] == results[0]);
+    }
+    CHECK_EQ(results[3][1234].str(), "string 1234");
+
+    // Outside of a document, interned strings are written as plain strings.
+    {
+        std::ostringstream stream{};
+        tree::cbor::Writer writer{stream};
+        auto map = writer.start();
+        tree::intern::serialize(a, map, "val");
+        map.close();
+        auto read = tree::cbor::Reader(stream.str()).as_map();
+        CHECK(read.at("val").is_string());
+        CHECK(tree::intern::deserialize(read.at("val")) == a);
+    }
+
+    // Within a document, they are written as references into the string
+    // table, which is written once.
+    {
+        std::ostringstream stream{};
+        tree::cbor::Writer writer{stream};
+        auto map = writer.start();
+        tree::intern::StringTable table{};
+        {
+            tree::intern::TableScope scope{&table};
+            tree::intern::serialize(a, map, "x");
+            tree::intern::serialize(c, map, "y");
+            tree::intern::serialize(b, map, "z");
+        }
+        CHECK_EQ(table.size(), 2u);
+        table.serialize(map);
+        map.close();
+        auto read = tree::cbor::Reader(stream.str()).as_map();
+        CHECK(read.at("z").is_map());
+        CHECK_RAISES(std::runtime_error, tree::intern::deserialize(read.at("z")));
+        auto strings = tree::intern::StringTable::deserialize(read);
+        tree::intern::TableScope scope{&strings};
+        CHECK(tree::intern::deserialize(read.at("x")) == a);
+        CHECK(tree::intern::deserialize(read.at("y")) == c);
+        CHECK(tree::intern::deserialize(read.at("z")) == a);
+        CHECK_RAISES(std::runtime_error, strings.at(2));
+    }
+    CHECK(tree::intern::current_table() == nullptr);
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include "tree-location.hpp"
+#include "assert.hpp"
+
+using tree::location::SourceLocation;
+using tree::location::LocationColumn;
+
+/**
+ * Serializes the given column into a map and returns the encoded map.
+ */
+static std::string serialize_column(const LocationColumn &column) {
+    std::ostringstream stream{};
+    tree::cbor::Writer writer{stream};
+    auto map = writer.start();
+    column.serialize(map);
+    map.close();
+    return stream.str();
+}
+
+int main() {
+
+    // Locations are packed into 64 bits, with the file name stored in a
+    // process-wide table.
+    CHECK_EQ(sizeof(SourceLocation), 8u);
+    SourceLocation a{"a.txt", 12, 3, 7};
+    CHECK(a);
+    CHECK_EQ(a.filename(), "a.txt");
+    CHECK_EQ(a.line(), 12u);
+    CHECK_EQ(a.column(), 3u);
+    CHECK_EQ(a.span(), 7u);
+    CHECK(SourceLocation("a.txt", 1).file_id() == a.file_id());
+    CHECK(SourceLocation("b.txt", 1).file_id() != a.file_id());
+    CHECK(!SourceLocation());
+
+    // Values that don't fit are saturated.
+    SourceLocation big{"a.txt", 100000000, 100000, 100000};
+    CHECK_EQ(big.line(), SourceLocation::MAX_LINE);
+    CHECK_EQ(big.column(), SourceLocation::MAX_COLUMN);
+    CHECK_EQ(big.span(), SourceLocation::MAX_SPAN);
+
+    // Printing.
+    std::ostringstream ss{};
+    ss << a << " " << SourceLocation("b.txt", 4, 5);
+    CHECK_EQ(ss.str(), "a.txt:12:3+7 b.txt:4:5");
+
+    // Columns round-trip, including gaps and lines that go backwards.
+    LocationColumn column{};
+    column.set(1, a);
+    column.set(2, SourceLocation("b.txt", 4, 5));
+    column.set(5, SourceLocation("a.txt", 20));
+    column.set(9, SourceLocation());
+    CHECK(column.get(1) == a);
+    CHECK(!column.get(0));
+    CHECK(!column.get(100));
+    auto data = serialize_column(column);
+    auto read = LocationColumn::deserialize(tree::cbor::Reader(data).as_map());
+    for (size_t i = 0; i < 10; i++) {
+        CHECK(read.get(i) == column.get(i));
+    }
+
+    // Empty columns aren't written at all.
+    auto empty = tree::cbor::Reader(serialize_column(LocationColumn())).as_map();
+    CHECK(empty.find("@L") == empty.end());
+    CHECK(!LocationColumn::deserialize(empty).get(0));
+
+    // Malformed columns are rejected.
+    {
+        std::ostringstream stream{};
+        tree::cbor::Writer writer{stream};
+        auto map = writer.start();
+        auto col = map.append_map("@L");
+        col.append_array("f").close();
+        col.append_binary("d", std::string("\x01\x02\x03\x04", 4));
+        col.close();
+        map.close();
+        auto bad = tree::cbor::Reader(stream.str()).as_map();
+        CHECK_RAISES(std::runtime_error, LocationColumn::deserialize(bad));
+    }
+
+    // Scopes nest.
+    CHECK(tree::location::current_column() == nullptr);
+    {
+        tree::location::ColumnScope outer{&column};
+        {
+            tree::location::ColumnScope inner{&read};
+            CHECK(tree::location::current_column() == &read);
+        }
+        CHECK(tree::location::current_column() == &column);
+    }
+    CHECK(tree::location::current_column() == nullptr);
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
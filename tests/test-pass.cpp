@@ -0,0 +1,60 @@
+#include <iostream>
+#include <atomic>
+#include <stdexcept>
+#include "tree-pass.hpp"
+#include "assert.hpp"
+
+using tree::pass::PassInfo;
+
+struct TypeA {};
+struct TypeB {};
+struct TypeC {};
+
+int main() {
+
+    // Passes that don't interfere share a stage; a pass that reads what an
+    // earlier pass in the current stage writes starts a new one.
+    std::vector<PassInfo> passes = {
+        {"a", {}, {typeid(TypeA)}, false},
+        {"b", {}, {typeid(TypeB)}, false},
+        {"c", {typeid(TypeA)}, {}, false},
+        {"d", {typeid(TypeB)}, {typeid(TypeC)}, false},
+        {"e", {}, {}, true},
+        {"f", {}, {}, false},
+        {"g", {}, {}, false},
+    };
+    auto stages = tree::pass::schedule(passes);
+    ASSERT_EQ(stages.size(), 4u);
+    CHECK(stages[0] == std::vector<size_t>({0, 1}));
+    CHECK(stages[1] == std::vector<size_t>({2, 3}));
+    CHECK(stages[2] == std::vector<size_t>({4}));
+    CHECK(stages[3] == std::vector<size_t>({5, 6}));
+    CHECK(passes[0].conflicts_with(passes[2]));
+    CHECK(passes[2].conflicts_with(passes[0]));
+    CHECK(!passes[2].conflicts_with(passes[3]));
+    CHECK(!passes[5].uses_annotations());
+    CHECK(tree::pass::schedule({}).empty());
+
+    // The thread pool runs all tasks.
+    tree::parallel::ThreadPool pool{4};
+    CHECK_EQ(pool.size(), 4u);
+    std::atomic<int> counter{0};
+    for (int i = 0; i < 100; i++) {
+        pool.submit([&counter]() { counter++; });
+    }
+    pool.wait();
+    CHECK_EQ(counter.load(), 100);
+
+    // Exceptions are propagated to wait(), after which the pool is usable
+    // again.
+    pool.submit([]() { throw std::runtime_error("oops"); });
+    pool.submit([&counter]() { counter++; });
+    CHECK_RAISES(std::runtime_error, pool.wait());
+    CHECK_EQ(counter.load(), 101);
+    pool.submit([&counter]() { counter++; });
+    pool.wait();
+    CHECK_EQ(counter.load(), 102);
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <sstream>
+
+// This test is built together with the support library with TREE_STATS set
+// on the command line, the way applications enable instrumentation, and
+// includes the public headers rather than the macro-configurable sources.
+#include "tree-base.hpp"
+
+#include "assert.hpp"
+
+#if !TREE_STATS
+#error "TREE_STATS was reset by the support library headers"
+#endif
+
+int main() {
+    CHECK(tree::stats::ENABLED);
+
+    // Write some CBOR to read back.
+    std::ostringstream ss{};
+    tree::cbor::Writer writer{ss};
+    auto map = writer.start();
+    map.append_int("value", 3);
+    map.close();
+    std::string encoded = ss.str();
+
+    // The counters in the library and in the headers must both be live.
+    tree::stats::Stats stats{};
+    {
+        tree::stats::Collector collector{stats};
+        tree::cbor::Reader(encoded).as_map();
+        tree::base::PointerMap ids{};
+        int node = 0;
+        ids.add_ref(node);
+        tree::stats::count(&tree::stats::Stats::links_restored);
+    }
+    CHECK_EQ(stats.bytes_read, encoded.size());
+    CHECK_EQ(stats.as_map_calls, 1u);
+    CHECK_EQ(stats.nodes_visited, 1u);
+    CHECK_EQ(stats.links_restored, 1u);
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Build a private copy of the support library with instrumentation enabled,
+// using the macro configuration mechanism.
+#define TREE_NAMESPACE_BEGIN namespace instrumented {
+#define TREE_NAMESPACE_END }
+#define TREE_STATS 1
+#include "tree-all.cpp.inc"
+
+#include "assert.hpp"
+
+using namespace instrumented;
+
+int main() {
+    CHECK(stats::ENABLED);
+    CHECK(stats::current() == nullptr);
+
+    // Write some CBOR to read back.
+    std::ostringstream ss{};
+    cbor::Writer writer{ss};
+    auto map = writer.start();
+    auto ar = map.append_array("array");
+    ar.append_map().close();
+    ar.append_int(3);
+    ar.close();
+    map.close();
+    std::string encoded = ss.str();
+
+    // Nothing is collected without a collector.
+    cbor::Reader(encoded).as_map();
+
+    std::vector<std::string> hook_calls;
+    stats::set_hook([&hook_calls](const std::string &operation, const stats::Stats &stats) {
+        hook_calls.push_back(operation);
+        (void)stats;
+    });
+
+    // Collect statistics for reading, with a nested collector for part of it.
+    stats::Stats outer{};
+    stats::Stats inner{};
+    {
+        stats::Collector collector{outer, "outer"};
+        CHECK(stats::current() == &outer);
+        auto reader = cbor::Reader(encoded);
+        CHECK_EQ(outer.bytes_read, encoded.size());
+        CHECK_EQ(outer.validation_passes, 1u);
+        auto array = reader.as_map().at("array");
+        {
+            stats::Collector nested{inner, "inner"};
+            CHECK(stats::current() == &inner);
+            array.as_array().at(0).as_map();
+            CHECK_EQ(inner.as_map_calls, 1u);
+            CHECK_EQ(inner.containers_allocated, 2u);
+        }
+        CHECK(stats::current() == &outer);
+        CHECK_EQ(outer.as_map_calls, 2u);
+        CHECK_EQ(outer.containers_allocated, 3u);
+        cbor::Reader(encoded, false);
+        CHECK_EQ(outer.validation_passes, 1u);
+        CHECK_EQ(outer.bytes_read, 2 * encoded.size());
+    }
+    CHECK(stats::current() == nullptr);
+    CHECK_EQ(hook_calls.size(), 2u);
+    CHECK_EQ(hook_calls.at(0), "inner");
+    CHECK_EQ(hook_calls.at(1), "outer");
+
+    // Timers only add time to active collectors.
+    {
+        stats::Collector collector{outer};
+        stats::Timer timer{&stats::Stats::decode_time};
+    }
+    CHECK(outer.decode_time >= 0.0);
+    stats::set_hook(stats::Hook());
+
+    // Test the arithmetic.
+    stats::Stats sum = outer;
+    sum += inner;
+    CHECK_EQ(sum.as_map_calls, 3u);
+    CHECK_EQ((sum - inner).as_map_calls, 2u);
+
+    std::cout << "Test passed" << std::endl;
+    return 0;
+}